@@ -0,0 +1,130 @@
+#ifndef _PAREAS_COMMON_HOST_LEXER_HPP
+#define _PAREAS_COMMON_HOST_LEXER_HPP
+
+#include <array>
+#include <vector>
+#include <variant>
+#include <optional>
+#include <string_view>
+#include <stdexcept>
+#include <cstddef>
+#include <cstdint>
+
+namespace pareas {
+    enum class LexerBackend {
+        // Lex inputs smaller than the host threshold on the host using the DFA, and other inputs on the device.
+        AUTO,
+        DEVICE,
+        // Lex on the host by composing states through the merge table, see HostLexer::lex.
+        HOST,
+        // Lex on the host using the sequential DFA and speculation, see HostLexer::lex_dfa.
+        DFA,
+    };
+
+    std::optional<LexerBackend> parse_lexer_backend(std::string_view name);
+
+    // Below this size, launching the device lexer generally takes longer than lexing on the host.
+    constexpr const size_t DEFAULT_HOST_LEXER_THRESHOLD = 256 * 1024;
+
+    struct LexerOptions {
+        LexerBackend backend;
+        // Size in bytes below which the host lexer is used when the backend is AUTO.
+        size_t host_threshold;
+        // Maximum number of threads used by the host lexer, 0 for the amount of cores.
+        unsigned host_threads;
+
+        bool use_host(size_t input_size) const;
+    };
+
+    struct InputTooLargeError: std::runtime_error {
+        InputTooLargeError(): std::runtime_error("Input is too large for the host lexer") {}
+    };
+
+    // Lexer that runs the tables generated by pareas-lpg on the host, and produces exactly the same tokens as
+    // the lexer in src/compiler/lexer/lexer.fut. For small inputs, this is cheaper than launching the device lexer.
+    //
+    // There are two engines, both of which split the input into a chunk per thread:
+    // - `lex` computes the composition of the initial states of every chunk independently, after which a
+    //   (sequential) prefix over these summaries gives the state in which every chunk starts. The tokens of
+    //   each chunk can then be computed independently again. If the processor supports AVX2, the summaries are
+    //   computed 8 parts of a chunk at once using gathers.
+    // - `lex_dfa` runs the DFA from which the parallel states are built. Every chunk is first lexed from all
+    //   DFA states at once, until these runs converge to a single state, which usually happens within a few
+    //   bytes. The rest of the chunk is then lexed speculatively from that state. Once the start state of every
+    //   chunk is known, only the bytes before the point of convergence need to be lexed again.
+    //   The DFA table is small enough to stay in cache, unlike the merge table.
+    class HostLexer {
+    public:
+        using TokenType = uint8_t;
+
+        // The tables of a LexTable generated by pareas-lpg, with states of type `S`. Only grammars with 8-bit
+        // token types are supported.
+        template <typename S>
+        struct BasicTables {
+            size_t n;
+            size_t num_byte_classes;
+            const uint8_t* byte_classes; // 256
+            const S* initial_states; // indexed by byte class
+            const S* merge_table; // n * n, followed by padding up to a 32-bit word
+            const TokenType* final_states; // n
+            S identity_state;
+            size_t num_dfa_states;
+            const S* dfa_transitions; // num_dfa_states * num_byte_classes
+            const TokenType* dfa_final_states; // num_dfa_states
+            S dfa_start_state;
+        };
+
+        // The state width is chosen per grammar by `ParallelLexer::state_bits`. Tables with 8-bit states are
+        // widened to 16 bits when the lexer is constructed, the others are used as-is.
+        using NarrowTables = BasicTables<uint8_t>;
+        using Tables = BasicTables<uint16_t>;
+        using WideTables = BasicTables<uint32_t>;
+
+        // Tokens in structure-of-arrays form, so that they can be uploaded to the device directly.
+        // Like the device lexer, tokens cover the entire input, including whitespace and comments.
+        struct Tokens {
+            std::vector<TokenType> types;
+            std::vector<int32_t> offsets;
+            std::vector<int32_t> lengths;
+
+            size_t size() const {
+                return this->types.size();
+            }
+        };
+
+    private:
+        // Both engines, instantiated for states of type `S`.
+        template <typename S>
+        struct Engine {
+            BasicTables<S> tables;
+            // The initial state of every byte, with the produces-token flag masked off.
+            std::array<uint32_t, 256> initial_state;
+            // The DFA transition table, indexed by state * 256 + byte rather than by byte class.
+            std::vector<S> dfa_table;
+
+            explicit Engine(const BasicTables<S>& tables);
+
+            Tokens lex(std::string_view input, unsigned threads, bool use_avx2) const;
+            Tokens lex_dfa(std::string_view input, unsigned threads) const;
+        };
+
+        // Storage of the widened state tables, if this lexer was constructed from `NarrowTables`.
+        std::vector<uint16_t> widened_states;
+        std::variant<Engine<uint16_t>, Engine<uint32_t>> engine;
+        bool use_avx2;
+
+    public:
+        explicit HostLexer(const NarrowTables& tables);
+        explicit HostLexer(const Tables& tables);
+        explicit HostLexer(const WideTables& tables);
+
+        // Both of these throw InputTooLargeError if the input is too large to be addressed using 32-bit offsets.
+        Tokens lex(std::string_view input, unsigned threads = 0) const;
+        Tokens lex_dfa(std::string_view input, unsigned threads = 0) const;
+
+        // Lex using the engine selected by the options. The DFA engine is used unless HOST is selected.
+        Tokens lex(std::string_view input, const LexerOptions& opts) const;
+    };
+}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef _PAREAS_COMMON_INPUT_FILE_HPP
+#define _PAREAS_COMMON_INPUT_FILE_HPP
+
+#include <string_view>
+#include <string>
+#include <memory>
+#include <cstddef>
+
+namespace pareas {
+    // Read-only contents of an input file. Regular files are memory mapped, so that their
+    // contents can be passed to the Futhark array constructors without an intermediate copy.
+    // Files that cannot be mapped, such as pipes and terminals, are read into a buffer instead.
+    // The path "-" refers to standard input.
+    class InputFile {
+        const char* data;
+        size_t size;
+        bool mapped;
+        std::unique_ptr<char[]> buffer;
+
+    public:
+        // Throws std::system_error if the file could not be opened or read.
+        explicit InputFile(const char* path);
+
+        InputFile(InputFile&& other);
+        InputFile& operator=(InputFile&& other);
+
+        InputFile(const InputFile&) = delete;
+        InputFile& operator=(const InputFile&) = delete;
+
+        ~InputFile();
+
+        std::string_view contents() const {
+            return std::string_view(this->data, this->size);
+        }
+
+        bool is_mapped() const {
+            return this->mapped;
+        }
+    };
+
+    // Sequential reader for inputs that are processed one part at a time, and so never need to be
+    // in memory as a whole. The path "-" refers to standard input.
+    class InputStream {
+        int fd;
+        std::string path;
+
+    public:
+        // Throws std::system_error if the file could not be opened.
+        explicit InputStream(const char* path);
+
+        InputStream(const InputStream&) = delete;
+        InputStream& operator=(const InputStream&) = delete;
+
+        ~InputStream();
+
+        // Read up to `size` bytes into `buffer`, and return the number of bytes read. Fewer than `size`
+        // bytes are only returned at the end of the input. Throws std::system_error if reading fails.
+        size_t read(char* buffer, size_t size);
+    };
+}
+
+#endif
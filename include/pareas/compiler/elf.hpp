@@ -0,0 +1,36 @@
+#ifndef _PAREAS_COMPILER_ELF_HPP
+#define _PAREAS_COMPILER_ELF_HPP
+
+#include "pareas/compiler/module.hpp"
+
+#include <cstdint>
+
+namespace elf {
+    enum class FileType {
+        // A relocatable object file, with a global symbol for every function.
+        RELOCATABLE,
+        // A statically linked executable, with a small startup stub that calls the entry
+        // function and exits with its return value as exit code.
+        EXECUTABLE,
+    };
+
+    enum class Class {
+        ELF32,
+        ELF64,
+    };
+
+    struct Options {
+        FileType type;
+        Class elf_class;
+        // The id of the function called by the startup stub, only used for executables.
+        uint32_t entry_function;
+    };
+
+    // Write a module as RISC-V ELF file to the file descriptor `fd`. Function symbols are named
+    // `fn<id>`. The file is written using a single vectored write, the instructions of the module
+    // are not copied. Throws std::system_error if writing fails, and std::runtime_error if the
+    // module cannot be represented.
+    void write(int fd, const HostModule& mod, const Options& opts);
+}
+
+#endif
@@ -4,9 +4,12 @@
 #include "futhark_generated.h"
 
 #include "pareas/compiler/ast.hpp"
+#include "pareas/compiler/futhark_interop.hpp"
 #include "pareas/profiler/profiler.hpp"
+#include "pareas/common/host_lexer.hpp"
 
 #include <chrono>
+#include <string_view>
 #include <stdexcept>
 #include <iosfwd>
 #include <cstdio>
@@ -35,7 +38,30 @@ namespace frontend {
             std::runtime_error(error_name(e)) {}
     };
 
-    DeviceAst compile(futhark_context* ctx, const std::string& input, bool verbose_tree, pareas::Profiler& p, std::FILE* debug_log);
+    // Device-side copies of the generated grammar tables, and the host lexer over the generated lex table.
+    // These do not depend on the input, so they can be uploaded once and shared between any number of compilations.
+    struct GrammarTables {
+        pareas::HostLexer host_lexer;
+        futhark::UniqueLexTable lex_table;
+        futhark::UniqueStackChangeTable stack_change_table;
+        futhark::UniqueParseTable parse_table;
+        futhark::UniqueArray<int32_t, 1> arities;
+    };
+
+    GrammarTables upload_tables(futhark_context* ctx);
+
+    // If `fused` is set, all syntax passes are run by the single entry point `frontend_syntax`, instead of one entry
+    // point per pass. The unfused passes are profiled separately, and can be inspected with `verbose_tree`.
+    DeviceAst compile(
+        futhark_context* ctx,
+        const GrammarTables& tables,
+        std::string_view input,
+        const pareas::LexerOptions& lexer_opts,
+        bool fused,
+        bool verbose_tree,
+        pareas::Profiler& p,
+        std::FILE* debug_log
+    );
 }
 
 #endif
@@ -11,6 +11,16 @@
 #include <cstdint>
 #include <cassert>
 #include <cstdio>
+#include <type_traits>
+
+// The array types of every lexer state width, see `futhark::ArrayTraits` below. The generated header only
+// declares those that appear in an entry point.
+struct futhark_u8_1d;
+struct futhark_u16_1d;
+struct futhark_u32_1d;
+struct futhark_u8_2d;
+struct futhark_u16_2d;
+struct futhark_u32_2d;
 
 namespace futhark {
     template <typename T, void(*deleter)(T*)>
@@ -110,6 +120,16 @@ namespace futhark {
     using UniqueFuncInfoArray = UniqueOpaqueArray<futhark_opaque_arr_FuncInfo_1d, futhark_free_opaque_arr_FuncInfo_1d>;
     using UniqueInstrArray = UniqueOpaqueArray<futhark_opaque_arr_Instr_1d, futhark_free_opaque_arr_Instr_1d>;
 
+    // Totals of the device arrays released through `UniqueArray` on this thread. Entry points allocate their
+    // outputs themselves, and Futhark recycles released memory through the free list of the context (see
+    // `futhark_context_clear_caches`), so the arrays released while a pass runs measure the churn it causes.
+    struct ReleaseCounters {
+        int64_t arrays = 0;
+        int64_t bytes = 0;
+    };
+
+    inline thread_local ReleaseCounters release_counters;
+
     template <typename T, size_t N>
     struct ArrayTraits;
 
@@ -134,7 +154,15 @@ namespace futhark {
                 throw Error(this->handle.ctx);
         }
 
+        UniqueArray(UniqueArray&&) = default;
+        UniqueArray& operator=(UniqueArray&&) = default;
+
+        ~UniqueArray() {
+            this->count_release();
+        }
+
         void clear() {
+            this->count_release();
             this->handle.clear();
         }
 
@@ -173,6 +201,20 @@ namespace futhark {
             this->values(out.data());
             return out;
         }
+
+    private:
+        void count_release() {
+            if (!this->handle.data)
+                return;
+
+            const auto* dims = this->shape();
+            int64_t size = sizeof(T);
+            for (size_t i = 0; i < N; ++i)
+                size *= dims[i];
+
+            ++release_counters.arrays;
+            release_counters.bytes += size;
+        }
     };
 
     template <>
@@ -193,24 +235,6 @@ namespace futhark {
         constexpr static const auto values_fn = futhark_values_u8_1d;
     };
 
-    template <>
-    struct ArrayTraits<uint16_t, 1> {
-        using Array = futhark_u16_1d;
-        constexpr static const auto new_fn = futhark_new_u16_1d;
-        constexpr static const auto free_fn = futhark_free_u16_1d;
-        constexpr static const auto shape_fn = futhark_shape_u16_1d;
-        constexpr static const auto values_fn = futhark_values_u16_1d;
-    };
-
-    template <>
-    struct ArrayTraits<uint16_t, 2> {
-        using Array = futhark_u16_2d;
-        constexpr static const auto new_fn = futhark_new_u16_2d;
-        constexpr static const auto free_fn = futhark_free_u16_2d;
-        constexpr static const auto shape_fn = futhark_shape_u16_2d;
-        constexpr static const auto values_fn = futhark_values_u16_2d;
-    };
-
     template <>
     struct ArrayTraits<uint32_t, 1> {
         using Array = futhark_u32_1d;
@@ -246,6 +270,57 @@ namespace futhark {
         constexpr static const auto shape_fn = futhark_shape_i64_1d;
         constexpr static const auto values_fn = futhark_values_i64_1d;
     };
+
+    // Arrays of lexer states. pareas-lpg chooses the width of these per grammar (see `ParallelLexer::state_bits`),
+    // and Futhark only generates the functions of array types that appear in an entry point. The functions are
+    // therefore looked up through the array type, which depends on `T`, so that only the functions of the arrays
+    // that are actually used need to exist.
+    template <typename T, size_t N>
+        requires (std::is_same_v<T, uint8_t> || std::is_same_v<T, uint16_t> || std::is_same_v<T, uint32_t>) && (N == 1 || N == 2)
+    struct ArrayTraits<T, N> {
+        using Array = std::conditional_t<
+            N == 1,
+            std::conditional_t<sizeof(T) == 1, futhark_u8_1d, std::conditional_t<sizeof(T) == 2, futhark_u16_1d, futhark_u32_1d>>,
+            std::conditional_t<sizeof(T) == 1, futhark_u8_2d, std::conditional_t<sizeof(T) == 2, futhark_u16_2d, futhark_u32_2d>>
+        >;
+
+        template <typename... Sizes>
+        static Array* new_fn(futhark_context* ctx, const T* data, Sizes... dims) {
+            if constexpr (std::is_same_v<Array, futhark_u8_1d>) return futhark_new_u8_1d(ctx, data, dims...);
+            else if constexpr (std::is_same_v<Array, futhark_u16_1d>) return futhark_new_u16_1d(ctx, data, dims...);
+            else if constexpr (std::is_same_v<Array, futhark_u32_1d>) return futhark_new_u32_1d(ctx, data, dims...);
+            else if constexpr (std::is_same_v<Array, futhark_u8_2d>) return futhark_new_u8_2d(ctx, data, dims...);
+            else if constexpr (std::is_same_v<Array, futhark_u16_2d>) return futhark_new_u16_2d(ctx, data, dims...);
+            else return futhark_new_u32_2d(ctx, data, dims...);
+        }
+
+        static int free_fn(futhark_context* ctx, Array* arr) {
+            if constexpr (std::is_same_v<Array, futhark_u8_1d>) return futhark_free_u8_1d(ctx, arr);
+            else if constexpr (std::is_same_v<Array, futhark_u16_1d>) return futhark_free_u16_1d(ctx, arr);
+            else if constexpr (std::is_same_v<Array, futhark_u32_1d>) return futhark_free_u32_1d(ctx, arr);
+            else if constexpr (std::is_same_v<Array, futhark_u8_2d>) return futhark_free_u8_2d(ctx, arr);
+            else if constexpr (std::is_same_v<Array, futhark_u16_2d>) return futhark_free_u16_2d(ctx, arr);
+            else return futhark_free_u32_2d(ctx, arr);
+        }
+
+        static const int64_t* shape_fn(futhark_context* ctx, Array* arr) {
+            if constexpr (std::is_same_v<Array, futhark_u8_1d>) return futhark_shape_u8_1d(ctx, arr);
+            else if constexpr (std::is_same_v<Array, futhark_u16_1d>) return futhark_shape_u16_1d(ctx, arr);
+            else if constexpr (std::is_same_v<Array, futhark_u32_1d>) return futhark_shape_u32_1d(ctx, arr);
+            else if constexpr (std::is_same_v<Array, futhark_u8_2d>) return futhark_shape_u8_2d(ctx, arr);
+            else if constexpr (std::is_same_v<Array, futhark_u16_2d>) return futhark_shape_u16_2d(ctx, arr);
+            else return futhark_shape_u32_2d(ctx, arr);
+        }
+
+        static int values_fn(futhark_context* ctx, Array* arr, T* data) {
+            if constexpr (std::is_same_v<Array, futhark_u8_1d>) return futhark_values_u8_1d(ctx, arr, data);
+            else if constexpr (std::is_same_v<Array, futhark_u16_1d>) return futhark_values_u16_1d(ctx, arr, data);
+            else if constexpr (std::is_same_v<Array, futhark_u32_1d>) return futhark_values_u32_1d(ctx, arr, data);
+            else if constexpr (std::is_same_v<Array, futhark_u8_2d>) return futhark_values_u8_2d(ctx, arr, data);
+            else if constexpr (std::is_same_v<Array, futhark_u16_2d>) return futhark_values_u16_2d(ctx, arr, data);
+            else return futhark_values_u32_2d(ctx, arr, data);
+        }
+    };
 }
 
 #endif
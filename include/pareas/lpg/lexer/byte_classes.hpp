@@ -0,0 +1,43 @@
+#ifndef _PAREAS_LPG_LEXER_BYTE_CLASSES_HPP
+#define _PAREAS_LPG_LEXER_BYTE_CLASSES_HPP
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+
+namespace pareas::lexer {
+    // A partition of all bytes into classes of bytes which are treated identically by every regex of a lexical
+    // grammar. The lexer's automata are constructed over these classes rather than over individual bytes, which
+    // greatly reduces the number of transitions, as most grammars treat large ranges of bytes the same.
+    class ByteClasses {
+    public:
+        using ClassIndex = uint8_t;
+
+        constexpr const static size_t NUM_BYTES = 256;
+
+        using ByteSet = std::bitset<NUM_BYTES>;
+
+    private:
+        std::array<ClassIndex, NUM_BYTES> byte_class;
+        size_t num_classes;
+
+    public:
+        // Construct the partition consisting of a single class.
+        ByteClasses();
+
+        // Split classes such that every class is either a subset of `bytes` or disjoint from it. Classes
+        // are numbered in order of their lowest byte, so the result does not depend on the order in which
+        // sets are added.
+        void refine(const ByteSet& bytes);
+
+        size_t size() const;
+
+        ClassIndex operator[](uint8_t byte) const;
+
+        // Returns the set of classes that contain a byte of `bytes`.
+        ByteSet classes_of(const ByteSet& bytes) const;
+    };
+}
+
+#endif
@@ -12,6 +12,9 @@ namespace pareas::lexer {
     struct Lexeme;
     struct LexicalGrammar;
 
+    class ByteClasses;
+
+    // The symbols of the automata used to construct the lexer are byte classes, see ByteClasses.
     struct FiniteStateAutomaton {
         using Symbol = uint8_t;
         using StateIndex = size_t;
@@ -57,7 +60,13 @@ namespace pareas::lexer {
 
         void to_dfa(const LexicalGrammar* g, FiniteStateAutomaton& dfa, StateIndex nfa_start, StateIndex dfa_start) const;
 
-        static FiniteStateAutomaton build_lexer_dfa(const LexicalGrammar* g);
+        // Returns the equivalent DFA with the least number of states. This FSA must be a DFA. Two states are
+        // equivalent if they have the same lexeme, and if for every symbol the transitions lead to equivalent
+        // states and have the same produces_lexeme flag. States that cannot be reached from the start state are
+        // removed. The reject and start states keep their index.
+        FiniteStateAutomaton minimize() const;
+
+        static FiniteStateAutomaton build_lexer_dfa(const LexicalGrammar* g, const ByteClasses& classes);
     };
 }
 
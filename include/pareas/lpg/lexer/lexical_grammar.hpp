@@ -4,6 +4,7 @@
 #include "pareas/lpg/error_reporter.hpp"
 #include "pareas/lpg/token_mapping.hpp"
 #include "pareas/lpg/lexer/regex.hpp"
+#include "pareas/lpg/lexer/byte_classes.hpp"
 
 #include <string>
 #include <vector>
@@ -31,6 +32,9 @@ namespace pareas::lexer {
 
         void add_tokens(TokenMapping& tm) const;
 
+        // Compute the coarsest partition of bytes that are treated the same by all lexemes.
+        ByteClasses byte_classes() const;
+
         void validate(ErrorReporter& er) const;
     };
 }
@@ -3,11 +3,13 @@
 
 #include "pareas/lpg/lexer/lexical_grammar.hpp"
 #include "pareas/lpg/lexer/fsa.hpp"
+#include "pareas/lpg/lexer/byte_classes.hpp"
 
 #include <span>
 #include <memory>
 #include <vector>
 #include <limits>
+#include <chrono>
 #include <iosfwd>
 #include <cstdint>
 
@@ -50,7 +52,10 @@ namespace pareas::lexer {
             size_t states() const;
         };
 
-        // Char to initial state
+        // Byte to byte class
+        ByteClasses byte_classes;
+
+        // Byte class to initial state
         // Moving from the initial state could also produce a transition,
         // if the start state is accepting.
         std::vector<Transition> initial_states;
@@ -63,9 +68,44 @@ namespace pareas::lexer {
 
         StateIndex identity_state_index;
 
-        explicit ParallelLexer(const LexicalGrammar* g);
+        // Transition table of the (minimized) DFA the parallel states are built from, indexed by
+        // state * byte_classes.size() + byte class. Lexing with this table sequentially from START yields
+        // the same tokens as the parallel lexer, which is what host lexers use it for.
+        std::vector<Transition> dfa_transitions;
+
+        // DFA state to lexeme they might produce
+        std::vector<const Lexeme*> dfa_final_states;
+
+        // Number of states before and after minimization, for diagnostics.
+        size_t unminimized_dfa_states;
+        size_t dfa_states;
+        size_t unminimized_states;
+
+        // Time spent in every phase of the construction, also for diagnostics.
+        struct Timings {
+            std::chrono::microseconds dfa_construction;
+            std::chrono::microseconds dfa_minimization;
+            std::chrono::microseconds parallel_state_construction;
+            std::chrono::microseconds parallel_state_minimization;
+        };
+
+        Timings timings;
+
+        // The parallel states are constructed using at most `threads` threads, or one per core if 0.
+        explicit ParallelLexer(const LexicalGrammar* g, unsigned threads = 0);
+
+        const Transition& initial_state(uint8_t byte) const;
+
+        // The width of the states in the rendered tables: the smallest of 8, 16 or 32 bits that fits every
+        // parallel and DFA state as well as the produces-lexeme flag, which is stored in the highest bit.
+        size_t state_bits() const;
 
         void dump_sizes(std::ostream& out) const;
+        void dump_timings(std::ostream& out) const;
+
+    private:
+        // `produces_lexeme` holds the produces_lexeme flag of the transition from the start state, for every state.
+        void minimize(const std::vector<bool>& produces_lexeme);
     };
 }
 
@@ -3,6 +3,7 @@
 
 #include "pareas/lpg/lexer/fsa.hpp"
 #include "pareas/lpg/lexer/char_range.hpp"
+#include "pareas/lpg/lexer/byte_classes.hpp"
 
 #include <memory>
 #include <vector>
@@ -15,8 +16,11 @@ namespace pareas::lexer {
         using StateIndex = FiniteStateAutomaton::StateIndex;
 
         virtual void print(std::ostream& os) const = 0;
-        virtual StateIndex compile(FiniteStateAutomaton& fsa, StateIndex start) const = 0;
+        // Transitions are added on byte classes, which should be refined by `refine_byte_classes` of every
+        // regex that is compiled into the automaton.
+        virtual StateIndex compile(FiniteStateAutomaton& fsa, StateIndex start, const ByteClasses& classes) const = 0;
         virtual bool matches_empty() const = 0;
+        virtual void refine_byte_classes(ByteClasses& classes) const = 0;
 
         virtual ~RegexNode() = default;
     };
@@ -30,8 +34,9 @@ namespace pareas::lexer {
             children(std::move(children)) {}
 
         void print(std::ostream& os) const override;
-        StateIndex compile(FiniteStateAutomaton& fsa, StateIndex start) const override;
+        StateIndex compile(FiniteStateAutomaton& fsa, StateIndex start, const ByteClasses& classes) const override;
         bool matches_empty() const override;
+        void refine_byte_classes(ByteClasses& classes) const override;
     };
 
     struct AlternationNode: public RegexNode {
@@ -41,8 +46,9 @@ namespace pareas::lexer {
             children(std::move(children)) {}
 
         void print(std::ostream& os) const override;
-        StateIndex compile(FiniteStateAutomaton& fsa, StateIndex start) const override;
+        StateIndex compile(FiniteStateAutomaton& fsa, StateIndex start, const ByteClasses& classes) const override;
         bool matches_empty() const override;
+        void refine_byte_classes(ByteClasses& classes) const override;
     };
 
     enum class RepeatType {
@@ -59,8 +65,9 @@ namespace pareas::lexer {
             repeat_type(repeat_type), child(std::move(child)) {}
 
         void print(std::ostream& os) const override;
-        StateIndex compile(FiniteStateAutomaton& fsa, StateIndex start) const override;
+        StateIndex compile(FiniteStateAutomaton& fsa, StateIndex start, const ByteClasses& classes) const override;
         bool matches_empty() const override;
+        void refine_byte_classes(ByteClasses& classes) const override;
     };
 
     struct CharSetNode: public RegexNode {
@@ -70,9 +77,13 @@ namespace pareas::lexer {
         CharSetNode(std::vector<CharRange>&& ranges, bool inverted):
             ranges(std::move(ranges)), inverted(inverted) {}
 
+        // The set of bytes matched by this node.
+        ByteClasses::ByteSet bytes() const;
+
         void print(std::ostream& os) const override;
-        StateIndex compile(FiniteStateAutomaton& fsa, StateIndex start) const override;
+        StateIndex compile(FiniteStateAutomaton& fsa, StateIndex start, const ByteClasses& classes) const override;
         bool matches_empty() const override;
+        void refine_byte_classes(ByteClasses& classes) const override;
     };
 
     struct CharNode: public RegexNode {
@@ -82,16 +93,18 @@ namespace pareas::lexer {
             c(c) {}
 
         void print(std::ostream& os) const override;
-        StateIndex compile(FiniteStateAutomaton& fsa, StateIndex start) const override;
+        StateIndex compile(FiniteStateAutomaton& fsa, StateIndex start, const ByteClasses& classes) const override;
         bool matches_empty() const override;
+        void refine_byte_classes(ByteClasses& classes) const override;
     };
 
     struct EmptyNode: public RegexNode {
         EmptyNode() = default;
 
         void print(std::ostream& os) const override;
-        StateIndex compile(FiniteStateAutomaton& fsa, StateIndex start) const override;
+        StateIndex compile(FiniteStateAutomaton& fsa, StateIndex start, const ByteClasses& classes) const override;
         bool matches_empty() const override;
+        void refine_byte_classes(ByteClasses& classes) const override;
     };
 }
 
@@ -5,7 +5,8 @@
 #include "pareas/lpg/token_mapping.hpp"
 #include "pareas/lpg/lexer/parallel_lexer.hpp"
 
-#include <limits>
+#include <string>
+#include <string_view>
 #include <span>
 #include <iosfwd>
 #include <cstdint>
@@ -13,24 +14,26 @@
 
 namespace pareas::lexer {
     class LexerRenderer {
-        using EncodedTransition = uint16_t;
-        constexpr const static auto ENCODED_TRANSITION_BITS = std::numeric_limits<EncodedTransition>::digits;
-        constexpr const static auto PRODUCES_TOKEN_MASK = 1 << (ENCODED_TRANSITION_BITS - 1);
-
         Renderer* r;
         const TokenMapping* tm;
         const ParallelLexer* lexer;
+        size_t state_bits;
 
     public:
         LexerRenderer(Renderer* r, const TokenMapping* tm, const ParallelLexer* lexer);
         void render() const;
 
     private:
-        size_t render_initial_state_data() const;
-        size_t render_merge_table_data() const;
-        size_t render_final_state_data() const;
+        std::string render_byte_class_data() const;
+        std::string render_transition_data(std::string_view name, std::span<const ParallelLexer::Transition> transitions) const;
+        std::string render_merge_table_data() const;
+        std::string render_final_state_data(std::string_view name, std::span<const Lexeme* const> final_states) const;
+
+        uint64_t produces_lexeme_mask() const;
 
-        EncodedTransition encode(const ParallelLexer::Transition& t) const;
+        // Encode a transition as a state of `state_bits` bits (see `ParallelLexer::state_bits`), with the highest
+        // bit set if the transition produces a lexeme.
+        uint64_t encode(const ParallelLexer::Transition& t) const;
     };
 }
 
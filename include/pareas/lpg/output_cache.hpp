@@ -0,0 +1,49 @@
+#ifndef _PAREAS_LPG_OUTPUT_CACHE_HPP
+#define _PAREAS_LPG_OUTPUT_CACHE_HPP
+
+#include <filesystem>
+#include <string_view>
+#include <cstdint>
+
+namespace pareas {
+    // Content-addressed cache of generated output files. Every entry is a directory named after the key, holding
+    // the files of one invocation under their original file names. Entries are never modified after they
+    // are created, so they may be shared by concurrent invocations.
+    class OutputCache {
+        std::filesystem::path dir;
+        uint64_t key;
+
+    public:
+        // Bump this whenever a change to the generator changes its output for the same inputs.
+        constexpr const static std::string_view GENERATOR_VERSION = "pareas-lpg-3";
+
+        // The extensions of the files that may be written by `Renderer`.
+        constexpr const static std::string_view EXTENSIONS[] = {".hpp", ".cpp", ".dat", ".S", ".fut"};
+
+        OutputCache(const std::filesystem::path& dir, uint64_t key);
+
+        // Copy the cached files to `output` (see `Renderer`), and return whether there was an entry.
+        bool restore(const std::filesystem::path& output) const;
+        // Store the files previously written to `output` in the cache.
+        void store(const std::filesystem::path& output) const;
+
+    private:
+        std::filesystem::path entry() const;
+    };
+
+    // Incremental 64-bit FNV-1a hash, used to compute cache keys.
+    class Fnv1a {
+        constexpr const static uint64_t OFFSET_BASIS = 0xcbf29ce484222325ULL;
+        constexpr const static uint64_t PRIME = 0x100000001b3ULL;
+
+        uint64_t hash = OFFSET_BASIS;
+
+    public:
+        void update(std::string_view data);
+        // Hash the length of `data` before `data` itself, so that consecutive fields cannot alias.
+        void update_field(std::string_view data);
+        uint64_t digest() const;
+    };
+}
+
+#endif
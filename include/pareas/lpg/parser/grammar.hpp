@@ -6,6 +6,7 @@
 
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include <iosfwd>
 #include <stdexcept>
 #include <string_view>
@@ -94,14 +95,34 @@ namespace pareas::parser {
     struct Grammar {
         constexpr const static size_t START_INDEX = 0;
 
+        // Ids of the special terminals, see `intern_symbols`.
+        constexpr const static size_t EMPTY_ID = 0;
+        constexpr const static size_t START_OF_INPUT_ID = 1;
+        constexpr const static size_t END_OF_INPUT_ID = 2;
+
         std::vector<Production> productions;
 
+        // All terminals and non-terminals of the grammar, indexed by a dense id. These are filled by
+        // `intern_symbols`, after which the grammar analysis can represent sets of symbols as bitsets.
+        // Terminals and non-terminals are numbered separately.
+        std::vector<Terminal> terminals;
+        std::vector<NonTerminal> non_terminals;
+        std::unordered_map<Terminal, size_t, Terminal::Hash> terminal_ids;
+        std::unordered_map<NonTerminal, size_t, NonTerminal::Hash> non_terminal_ids;
+
         void dump(std::ostream& os) const;
         void validate(ErrorReporter& er) const;
         const Production* start() const;
         void add_tokens(TokenMapping& tm) const;
         void link_tokens(ErrorReporter& er, const TokenMapping& mapping) const;
 
+        // Assign ids to all symbols in the order in which they first appear, after the special terminals.
+        void intern_symbols();
+        size_t terminal_id(const Terminal& t) const;
+        size_t non_terminal_id(const NonTerminal& nt) const;
+        // The terminal id of `sym` if it is a terminal, and its non-terminal id otherwise.
+        size_t symbol_id(const Symbol& sym) const;
+
         size_t production_id(const Production* p) const;
         size_t production_backing_type_bits() const;
 
@@ -11,6 +11,8 @@
 #include "pareas/lpg/parser/llp/parsing_table.hpp"
 
 #include <unordered_set>
+#include <vector>
+#include <chrono>
 #include <iosfwd>
 
 namespace pareas::parser::llp {
@@ -19,19 +21,32 @@ namespace pareas::parser::llp {
         const Grammar* g;
         const TerminalSetFunctions* tsf;
 
+        ItemTable items;
         std::unordered_set<ItemSet, ItemSet::Hash> item_sets;
 
+        // The symbol codes (see `ItemTable`) of the right hand side of every production, indexed by production id.
+        std::vector<std::vector<size_t>> rhs_codes;
+        // The productions of every non-terminal, indexed by non-terminal id.
+        std::vector<std::vector<const Production*>> productions_by_lhs;
+        // The lookbacks of the items that the closure adds for every production, indexed by production id.
+        std::vector<TerminalSet> closure_lookbacks;
+
+        std::chrono::microseconds item_set_time;
+
     public:
         Generator(ErrorReporter* er, const Grammar* g, const TerminalSetFunctions* tsf);
         PSLSTable build_psls_table();
         ParsingTable build_parsing_table(const ll::ParsingTable& ll, const PSLSTable& psls);
         void dump(std::ostream& os);
+        void dump_sizes(std::ostream& os) const;
 
     private:
         void compute_item_sets();
-        ItemSet predecessor(const ItemSet& set, const Symbol& sym);
-        void closure(ItemSet& set);
-        std::vector<Symbol> compute_gamma(const Terminal& v, const Symbol& x, std::span<const Symbol> delta);
+        // `sym` is a symbol code, and the result is the list of new items, which may contain duplicates.
+        std::vector<size_t> predecessor(const ItemSet& set, size_t sym);
+        ItemSet closure(std::vector<size_t> items);
+        // Returns the id of the new gamma, `x` is a symbol code and `delta` a gamma id.
+        size_t compute_gamma(size_t v, size_t x, size_t delta);
     };
 }
 
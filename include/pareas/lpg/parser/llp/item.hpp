@@ -4,6 +4,7 @@
 #include "pareas/lpg/parser/grammar.hpp"
 
 #include <vector>
+#include <unordered_map>
 #include <iosfwd>
 #include <span>
 #include <cstddef>
@@ -12,9 +13,11 @@ namespace pareas::parser::llp {
     struct Item {
         const Production* prod;
         size_t dot;
-        Terminal lookback;
-        Terminal lookahead;
-        std::vector<Symbol> gamma;
+        // Terminal ids, see `Grammar::intern_symbols`.
+        size_t lookback;
+        size_t lookahead;
+        // Gamma id, see `ItemTable`.
+        size_t gamma;
 
         bool is_dot_at_end() const;
         bool is_dot_at_begin() const;
@@ -32,7 +35,52 @@ namespace pareas::parser::llp {
 
     bool operator==(const Item& lhs, const Item& rhs);
 
-    std::ostream& operator<<(std::ostream& os, const Item& item);
+    // Table that interns items and the symbol sequences of their gammas, so that both can be hashed and compared
+    // by id. Symbols of gammas are stored as codes: twice the id of a terminal, or twice the id of a non-terminal
+    // plus one. The codes and symbols of all gammas are stored in two arenas, of which each gamma is a span.
+    class ItemTable {
+        struct Span {
+            size_t offset;
+            size_t size;
+        };
+
+        struct CodesHash {
+            size_t operator()(const std::vector<size_t>& codes) const;
+        };
+
+        const Grammar* g;
+
+        std::vector<size_t> gamma_code_arena;
+        std::vector<Symbol> gamma_symbol_arena;
+        std::vector<Span> gamma_spans;
+        std::unordered_map<std::vector<size_t>, size_t, CodesHash> gamma_ids;
+
+        std::vector<Item> items;
+        std::unordered_map<Item, size_t, Item::Hash> item_ids;
+
+    public:
+        // Id of the empty gamma.
+        constexpr const static size_t EMPTY_GAMMA = 0;
+
+        explicit ItemTable(const Grammar* g);
+
+        size_t symbol_code(const Symbol& sym) const;
+        static bool is_terminal_code(size_t code);
+        // The terminal or non-terminal id of a symbol code.
+        static size_t symbol_id(size_t code);
+
+        size_t intern_gamma(std::span<const size_t> codes);
+        // Spans returned by these are invalidated by interning another gamma.
+        std::span<const size_t> gamma_codes(size_t gamma) const;
+        std::span<const Symbol> gamma(size_t gamma) const;
+        size_t num_gammas() const;
+
+        size_t intern(const Item& item);
+        const Item& operator[](size_t item) const;
+        size_t size() const;
+
+        void dump(std::ostream& os, size_t item) const;
+    };
 }
 
 #endif
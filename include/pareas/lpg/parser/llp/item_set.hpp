@@ -2,19 +2,21 @@
 #define _PAREAS_LPG_PARSER_LLP_ITEM_SET_HPP
 
 #include "pareas/lpg/parser/llp/item.hpp"
-#include "pareas/lpg/parser/grammar.hpp"
 
+#include <vector>
 #include <iosfwd>
-#include <unordered_set>
 #include <cstddef>
 
 namespace pareas::parser::llp {
+    // Set of items, stored as their ids in an `ItemTable`, in sorted order so that sets can be compared directly.
     struct ItemSet {
-        std::unordered_set<Item, Item::Hash> items;
+        std::vector<size_t> items;
+        size_t hash;
 
-        std::unordered_set<Symbol, Symbol::Hash> syms_before_dots() const;
-        std::unordered_set<Symbol, Symbol::Hash> syms_after_dots() const;
-        void dump(std::ostream& os) const;
+        // `items` may be in any order, and may contain duplicates.
+        explicit ItemSet(std::vector<size_t> items);
+
+        void dump(std::ostream& os, const ItemTable& table) const;
 
         struct Hash {
             size_t operator()(const ItemSet& item_set) const;
@@ -8,7 +8,9 @@
 
 #include <iosfwd>
 #include <unordered_map>
+#include <vector>
 #include <cstddef>
+#include <cstdint>
 
 namespace pareas::parser::llp {
     class ParserRenderer {
@@ -25,10 +27,16 @@ namespace pareas::parser::llp {
         ParserRenderer(Renderer* r, const TokenMapping* tm, const Grammar* g, const ParsingTable* pt);
         void render() const;
 
+        // Print the sizes of the stack change and parse tables, before and after compression.
+        void dump_sizes(std::ostream& os) const;
+
     private:
         uint64_t bracket_id(const Symbol& sym, bool left) const;
         size_t bracket_backing_bits() const;
 
+        std::vector<uint64_t> stack_change_string(const ParsingTable::Entry& entry) const;
+        std::vector<uint64_t> parse_string(const ParsingTable::Entry& entry) const;
+
         void render_productions() const;
 
         void render_production_arity_data() const;
@@ -3,19 +3,68 @@
 
 #include "pareas/lpg/parser/grammar.hpp"
 
-#include <unordered_map>
-#include <unordered_set>
+#include <vector>
 #include <span>
 #include <iosfwd>
+#include <cstddef>
+#include <cstdint>
 
 namespace pareas::parser {
-    using TerminalSet = std::unordered_set<Terminal, Terminal::Hash>;
-    using TerminalSetMap = std::unordered_map<NonTerminal, TerminalSet, NonTerminal::Hash>;
+    // Set of terminals of a grammar, as a bitset over their ids (see `Grammar::intern_symbols`).
+    class TerminalSet {
+        using Word = uint64_t;
+        constexpr const static size_t WORD_BITS = 64;
+        constexpr const static size_t NONE = -1;
+
+        std::vector<Word> words;
+
+    public:
+        class Iterator {
+            const TerminalSet* set;
+            size_t id;
+
+        public:
+            Iterator(const TerminalSet* set, size_t id);
+
+            size_t operator*() const;
+            Iterator& operator++();
+            bool operator==(const Iterator& other) const;
+        };
+
+        TerminalSet() = default;
+        // Construct an empty set for a grammar with `num_terminals` terminals.
+        explicit TerminalSet(size_t num_terminals);
+
+        bool contains(size_t id) const;
+        // Returns whether the terminal was not yet in the set.
+        bool insert(size_t id);
+        void erase(size_t id);
+
+        bool empty() const;
+        size_t size() const;
+
+        // Add all terminals of `other`, and return whether any terminal was added.
+        bool merge(const TerminalSet& other);
+        // Like `merge`, but skip the terminal `id`.
+        bool merge_except(const TerminalSet& other, size_t id);
+
+        // Iterate over the ids of the terminals in this set, in increasing order.
+        Iterator begin() const;
+        Iterator end() const;
+
+        bool operator==(const TerminalSet& other) const;
+
+    private:
+        size_t next(size_t id) const;
+    };
+
+    // Terminal set of every non-terminal, indexed by non-terminal id.
+    using TerminalSetMap = std::vector<TerminalSet>;
 
     bool merge_terminal_sets_omit_empty(TerminalSet& dst, const TerminalSet& src);
 
     struct TerminalSetFunctions {
-        ErrorReporter* er;
+        const Grammar* g;
 
         TerminalSetMap base_first_sets;
         TerminalSetMap base_last_sets;
@@ -31,16 +80,32 @@ namespace pareas::parser {
         const TerminalSet& follow(const NonTerminal& nt) const;
         const TerminalSet& before(const NonTerminal& nt) const;
 
+        // Like the above, but by non-terminal id.
+        const TerminalSet& first(size_t nt) const;
+        const TerminalSet& last(size_t nt) const;
+
+        const TerminalSet& follow(size_t nt) const;
+        const TerminalSet& before(size_t nt) const;
+
         TerminalSet compute_first(std::span<const Symbol> symbols) const;
         TerminalSet compute_last(std::span<const Symbol> symbols) const;
 
+        // The last set of the first `n` symbols of the right hand side of `prod`. These are precomputed,
+        // as the LLP generator requires them for every item.
+        const TerminalSet& last_of_prefix(const Production* prod, size_t n) const;
+
         void dump(std::ostream& os);
 
     private:
-        TerminalSetMap compute_base_first_or_last_set(const Grammar& g, bool first) const;
-        TerminalSetMap compute_follow_or_before_sets(const Grammar& g, bool follow) const;
+        // The symbol ids (see `Grammar::symbol_id`) of the right hand side of every production.
+        std::vector<std::vector<size_t>> rhs_ids;
+        // Indexed by production id and then by the length of the prefix.
+        std::vector<std::vector<TerminalSet>> prefix_last_sets;
+
+        TerminalSetMap compute_base_first_or_last_set(bool first) const;
+        TerminalSetMap compute_follow_or_before_sets(bool follow) const;
 
-        TerminalSet compute_first_or_last_set(std::span<const Symbol> symbols, bool first) const;
+        TerminalSet compute_first_or_last_set(std::span<const Symbol> symbols, std::span<const size_t> ids, bool first) const;
     };
 }
 
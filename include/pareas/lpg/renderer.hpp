@@ -6,6 +6,7 @@
 #include <string>
 #include <string_view>
 #include <fstream>
+#include <span>
 #include <cstdint>
 
 namespace pareas {
@@ -13,18 +14,50 @@ namespace pareas {
         RenderError(const std::string& msg): std::runtime_error(msg) {}
     };
 
+    // How table data is made available to the generated C++ code.
+    enum class Emit {
+        // Tables are written to a .dat file, which is embedded by a .S file using `.incbin`.
+        INCBIN,
+        // Tables are rendered as constexpr arrays in the header, so that the C++ compiler can see their contents.
+        // No .dat and .S files are written in this mode.
+        CONSTEXPR,
+    };
+
     struct Renderer {
         const char* namesp;
+        Emit emit;
 
         std::ofstream fut;
         std::ofstream hpp;
         std::ofstream cpp;
         std::ofstream dat;
 
-        Renderer(const char* namesp, const std::filesystem::path& output);
+        Renderer(const char* namesp, const std::filesystem::path& output, Emit emit = Emit::INCBIN);
 
         void finalize();
 
+        // How the elements of an array are represented in the generated C++ code.
+        enum class Element {
+            UNSIGNED,
+            // Values hold the two's complement representation of the element.
+            SIGNED,
+            // Elements of an enum class, which cannot be initialized from plain integers.
+            SCOPED_ENUM,
+        };
+
+        // Render `values` as an array `name` with elements of type `type`, which are `bytes` wide. Returns an
+        // expression of type `const type*` that points to the array.
+        std::string render_array(
+            std::string_view name,
+            std::string_view type,
+            size_t bytes,
+            std::span<const uint64_t> values,
+            Element element = Element::UNSIGNED
+        );
+
+        // Render the definition of a table object `name` of type `type`, and declare it in the header.
+        void render_definition(std::string_view type, std::string_view name, std::string_view init);
+
         void align_data(size_t align);
         size_t data_offset();
 
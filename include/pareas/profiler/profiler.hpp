@@ -5,6 +5,13 @@
 #include <chrono>
 #include <vector>
 #include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <thread>
+#include <cstddef>
+#include <cstdint>
 
 namespace pareas {
     struct Profiler {
@@ -12,27 +19,73 @@ namespace pareas {
 
         using Clock = std::chrono::high_resolution_clock;
 
+        enum class Format {
+            // `a.b.c: NNNus` lines, one per region.
+            TEXT,
+            // Chrome trace event JSON, which can be loaded in chrome://tracing or Perfetto.
+            CHROME_TRACE,
+            // One line per region, with a header.
+            CSV,
+        };
+
+        // When the sync callback is invoked. Syncing waits for all queued device work, which makes the time of
+        // every region accurate, but also serializes work that could otherwise overlap with the host.
+        enum class SyncMode {
+            // Sync at the start and end of every recorded region.
+            EAGER,
+            // Sync only at the start and end of the outermost recorded regions. The time of nested regions
+            // is then the host time spent enqueueing their work, rather than the time it takes to execute.
+            LAZY,
+        };
+
+        struct Counter {
+            const char* name;
+            int64_t value;
+        };
+
         struct HistoryEntry {
             unsigned level;
             const char* name;
+            Clock::time_point start;
             Clock::duration elapsed;
+            std::thread::id thread;
+            std::vector<Counter> counters;
+            // Whether the device was synced at both ends of the region. If not (nested regions in LAZY mode),
+            // `elapsed` only covers enqueueing its work, which is marked as such in the output.
+            bool synced;
+        };
+
+        struct OpenRegion {
+            Clock::time_point start;
+            std::thread::id thread;
+            std::vector<Counter> counters;
         };
 
         unsigned max_level;
         unsigned level;
 
         SyncCallback sync_callback;
-        std::vector<Clock::time_point> starts;
+        SyncMode sync_mode;
+        Clock::time_point origin;
+        std::vector<OpenRegion> starts;
         std::vector<HistoryEntry> history;
 
         Profiler(unsigned max_level);
 
         void set_sync_callback(SyncCallback sync_callback = null_callback);
+        void set_sync_mode(SyncMode sync_mode);
 
         void begin();
         void end(const char* name);
 
-        void dump(std::ostream& os);
+        // Add `value` to the counter `name` of the innermost recorded region.
+        void count(const char* name, int64_t value);
+
+        void dump(std::ostream& os, Format format = Format::TEXT) const;
+
+        // Record the regions of `other` as children of a new region `name`, which spans all of them. This
+        // combines multiple profiles into a single document.
+        void append(const Profiler& other, const char* name);
 
         template <typename F>
         void measure(const char* name, F f) {
@@ -42,6 +95,39 @@ namespace pareas {
         }
 
         static void null_callback() {}
+
+        static std::optional<Format> parse_format(std::string_view name);
+        static std::optional<SyncMode> parse_sync_mode(std::string_view name);
+
+        // Returns the recorded regions in order of appearance (parents before their children),
+        // together with their dotted paths.
+        std::vector<std::pair<std::string, HistoryEntry>> regions() const;
+
+    private:
+        void dump_text(std::ostream& os) const;
+        void dump_chrome_trace(std::ostream& os) const;
+        void dump_csv(std::ostream& os) const;
+    };
+
+    // Aggregates the regions of multiple profiles of the same computation by their dotted path.
+    struct ProfileStatistics {
+        struct Region {
+            std::string path;
+            std::vector<Profiler::Clock::duration> samples;
+            // Whether all samples were synced, see `Profiler::HistoryEntry::synced`.
+            bool synced;
+        };
+
+        // Regions in order of first appearance.
+        std::vector<Region> regions;
+
+        void add(const Profiler& p);
+
+        // Print runs, min, median, p95, mean and standard deviation per region. Only the text and
+        // CSV formats are supported, Chrome traces fall back to text. If `bytes` is nonzero, the
+        // throughput of every region in GB/s is reported as well, based on the median time it takes
+        // to process `bytes` bytes.
+        void dump(std::ostream& os, Profiler::Format format = Profiler::Format::TEXT, size_t bytes = 0) const;
     };
 }
 
@@ -0,0 +1,644 @@
+#include "pareas/common/host_lexer.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <variant>
+#include <memory>
+#include <thread>
+#include <stdexcept>
+#include <limits>
+#include <cassert>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    // The AVX2 lexer is compiled using target attributes, and only used if the processor supports it.
+    #define PAREAS_HOST_LEXER_AVX2
+    #include <immintrin.h>
+#endif
+
+namespace {
+    using TokenType = pareas::HostLexer::TokenType;
+    using Tokens = pareas::HostLexer::Tokens;
+    template <typename S>
+    using BasicTables = pareas::HostLexer::BasicTables<S>;
+    using NarrowTables = pareas::HostLexer::NarrowTables;
+    using Tables = pareas::HostLexer::Tables;
+
+    // Keep in sync with src/compiler/lexer/lexer.fut: the highest bit of a state is the produces-token flag.
+    template <typename S>
+    constexpr const S PRODUCES_TOKEN_MASK = S{1} << (sizeof(S) * 8 - 1);
+    template <typename S>
+    constexpr const S STATE_MASK = PRODUCES_TOKEN_MASK<S> - 1;
+
+    // Keep in sync with FiniteStateAutomaton::REJECT in include/pareas/lpg/lexer/fsa.hpp.
+    constexpr const uint32_t DFA_REJECT = 0;
+
+    // Inputs are only divided over multiple threads in chunks of at least this many bytes.
+    constexpr const size_t MIN_CHUNK_SIZE = 1 << 18;
+
+    // The number of lanes that are summarized at once by the AVX2 lexer, and the minimum size of these lanes.
+    constexpr const size_t LANES = 8;
+    constexpr const size_t MIN_LANE_SIZE = 1 << 12;
+
+    template <typename S>
+    struct Chunk {
+        using State = S;
+
+        size_t begin;
+        size_t end;
+
+        // The state in which this chunk starts, that is, after all bytes before it.
+        State prefix;
+        // The composition of the initial states of the bytes of this chunk.
+        State summary;
+        // The state after the last byte of this chunk.
+        State result;
+
+        // Types and exclusive end offsets of the tokens that end before a byte of this chunk. The final
+        // token of the input is not included, as it does not end before any byte. These buffers are
+        // allocated for the worst case of a token for every byte, but left uninitialized, so that only the
+        // pages that are actually written are touched.
+        std::unique_ptr<TokenType[]> types;
+        std::unique_ptr<int32_t[]> ends;
+        size_t num_tokens;
+
+        // For the DFA lexer: from `converged` onwards, the state does not depend on the start state of the chunk,
+        // unless that leads to the reject state. `mapping` gives the state at `converged` for every start state.
+        // If `speculated` is set, the bytes after that were lexed from the single non-reject state, and the
+        // resulting tokens are stored from offset `converged - begin` in the token buffers.
+        size_t converged;
+        std::vector<State> mapping;
+        bool speculated;
+        size_t num_speculative_tokens;
+        State speculative_result;
+
+        void allocate() {
+            size_t size = this->end - this->begin;
+            this->types.reset(new TokenType[size]);
+            this->ends.reset(new int32_t[size]);
+            this->num_tokens = 0;
+        }
+    };
+
+    template <typename S>
+    struct MergeAutomaton {
+        using State = S;
+
+        const BasicTables<S>& tables;
+        const uint32_t* initial_state;
+
+        State next(State state, uint8_t byte) const {
+            return this->tables.merge_table[(state & STATE_MASK<S>) * this->tables.n + this->initial_state[byte]];
+        }
+
+        TokenType token(State state) const {
+            return this->tables.final_states[state & STATE_MASK<S>];
+        }
+    };
+
+    template <typename S>
+    struct DfaAutomaton {
+        using State = S;
+
+        const State* table;
+        const TokenType* final_states;
+
+        State next(State state, uint8_t byte) const {
+            return this->table[(state & STATE_MASK<S>) * 256 + byte];
+        }
+
+        TokenType token(State state) const {
+            return this->final_states[state & STATE_MASK<S>];
+        }
+    };
+
+    // Lex `input[begin, end)` starting in `state`, and append the tokens which end before any of these bytes
+    // to `types` and `ends`. Returns the state after the last byte.
+    template <typename Automaton, typename State = typename Automaton::State>
+    State lex_range(
+        const Automaton& a,
+        const uint8_t* input,
+        size_t begin,
+        size_t end,
+        State state,
+        TokenType* types,
+        int32_t* ends,
+        size_t& num_tokens
+    ) {
+        // There is no token that ends before the first byte of the input.
+        if (begin == 0 && begin < end)
+            state = a.next(state, input[begin++]);
+
+        size_t n = num_tokens;
+        for (size_t i = begin; i < end; ++i) {
+            State next = a.next(state, input[i]);
+            // As in the device lexer, if the transition into a byte produces a token, the token that ends
+            // before that byte is given by the state moved away from. The token is always written, but
+            // only kept if it is produced, as token boundaries are too unpredictable to branch on.
+            types[n] = a.token(state);
+            ends[n] = i;
+            n += (next & PRODUCES_TOKEN_MASK<State>) != 0;
+            state = next;
+        }
+
+        num_tokens = n;
+        return state;
+    }
+
+    template <typename S>
+    struct ChunkLexer {
+        using State = S;
+        using Chunk = ::Chunk<S>;
+        constexpr static const S STATE_MASK = ::STATE_MASK<S>;
+
+        MergeAutomaton<S> a;
+        const uint8_t* input;
+        bool use_avx2;
+
+        State merge(State a, uint32_t b) const {
+            return this->a.tables.merge_table[(a & STATE_MASK) * this->a.tables.n + b];
+        }
+
+        State fold(size_t begin, size_t end, State state) const {
+            for (size_t i = begin; i < end; ++i)
+                state = this->a.next(state, this->input[i]);
+            return state;
+        }
+
+        void summarize(Chunk& chunk) const {
+            #if defined(PAREAS_HOST_LEXER_AVX2)
+                // The gathers index the merge table using 32-bit offsets.
+                bool fits = this->a.tables.n * this->a.tables.n <= size_t{std::numeric_limits<int32_t>::max()};
+                if (this->use_avx2 && fits && chunk.end - chunk.begin >= LANES * MIN_LANE_SIZE) {
+                    chunk.summary = this->summarize_lanes(chunk.begin, chunk.end);
+                    return;
+                }
+            #endif
+
+            chunk.summary = this->fold(chunk.begin, chunk.end, this->a.tables.identity_state);
+        }
+
+        // Lex the chunk starting from its prefix state, and record its tokens.
+        void emit(Chunk& chunk) const {
+            chunk.allocate();
+            chunk.result = lex_range(
+                this->a,
+                this->input,
+                chunk.begin,
+                chunk.end,
+                chunk.prefix,
+                chunk.types.get(),
+                chunk.ends.get(),
+                chunk.num_tokens
+            );
+        }
+
+    #if defined(PAREAS_HOST_LEXER_AVX2)
+        // Fold LANES consecutive parts of [begin, end) at once, and combine the results. Only the fold itself
+        // is vectorized: the lanes are independent, so that the gathers of different lanes can overlap.
+        __attribute__((target("avx2")))
+        State summarize_lanes(size_t begin, size_t end) const {
+            size_t lane_size = (end - begin) / LANES;
+            // Bytes are loaded 4 at a time per lane. The remaining bytes are folded by the scalar lexer.
+            size_t vector_size = lane_size & ~size_t{3};
+
+            alignas(32) int32_t offsets[LANES];
+            alignas(32) uint32_t states[LANES];
+            for (size_t lane = 0; lane < LANES; ++lane)
+                offsets[lane] = lane * lane_size;
+
+            const auto* base = this->input + begin;
+            const auto* initial_state = reinterpret_cast<const int*>(this->a.initial_state);
+            // Narrower elements of the merge table are gathered as the low bits of 32-bit words. The padding
+            // after the table makes sure that this does not read out of bounds.
+            const auto* merge_table = reinterpret_cast<const int*>(this->a.tables.merge_table);
+
+            const auto lane_offsets = _mm256_load_si256(reinterpret_cast<const __m256i*>(offsets));
+            const auto n = _mm256_set1_epi32(this->a.tables.n);
+            const auto state_mask = _mm256_set1_epi32(STATE_MASK);
+            const auto byte_mask = _mm256_set1_epi32(0xFF);
+
+            auto state = _mm256_set1_epi32(this->a.tables.identity_state);
+
+            for (size_t i = 0; i < vector_size; i += 4) {
+                auto words = _mm256_i32gather_epi32(reinterpret_cast<const int*>(base + i), lane_offsets, 1);
+
+                for (size_t k = 0; k < 4; ++k) {
+                    auto bytes = _mm256_and_si256(_mm256_srl_epi32(words, _mm_cvtsi32_si128(k * 8)), byte_mask);
+                    auto init = _mm256_i32gather_epi32(initial_state, bytes, 4);
+                    auto index = _mm256_add_epi32(_mm256_mullo_epi32(state, n), init);
+                    // The produces-token flag is not required here, so it is masked off along with the upper half.
+                    state = _mm256_and_si256(_mm256_i32gather_epi32(merge_table, index, sizeof(S)), state_mask);
+                }
+            }
+
+            _mm256_store_si256(reinterpret_cast<__m256i*>(states), state);
+
+            auto result = this->a.tables.identity_state;
+            for (size_t lane = 0; lane < LANES; ++lane) {
+                size_t lane_begin = begin + lane * lane_size;
+                size_t lane_end = lane == LANES - 1 ? end : lane_begin + lane_size;
+                auto summary = this->fold(lane_begin + vector_size, lane_end, states[lane]);
+                result = this->merge(result, summary & STATE_MASK);
+            }
+
+            return result;
+        }
+    #endif
+    };
+
+    template <typename S>
+    struct DfaLexer {
+        using State = S;
+        using Chunk = ::Chunk<S>;
+        constexpr static const S STATE_MASK = ::STATE_MASK<S>;
+
+        DfaAutomaton<S> a;
+        const uint8_t* input;
+        size_t num_states;
+        State start_state;
+
+        // Lex the chunk from all DFA states at once until these runs converge, and the rest of the chunk from the
+        // state they converged to. Runs which reach the reject state stay there, and are not taken into account.
+        void speculate(Chunk& chunk) const {
+            chunk.allocate();
+            chunk.mapping.resize(this->num_states);
+
+            // The first chunk always starts in the start state, so there is nothing to speculate about.
+            if (chunk.begin == 0) {
+                for (size_t s = 0; s < this->num_states; ++s)
+                    chunk.mapping[s] = s;
+                chunk.converged = chunk.begin;
+                this->lex_speculatively(chunk, this->start_state);
+                return;
+            }
+
+            constexpr const uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+            // The distinct states of all runs that did not reject yet, and for every start state the index of its
+            // run in `states`. Runs which end up in the same state are merged.
+            auto states = std::vector<State>();
+            auto run = std::vector<uint32_t>(this->num_states, NONE);
+            for (size_t s = 0; s < this->num_states; ++s) {
+                if (s == DFA_REJECT)
+                    continue;
+                run[s] = states.size();
+                states.push_back(s);
+            }
+
+            auto seen = std::vector<uint32_t>(this->num_states, NONE);
+            auto remap = std::vector<uint32_t>(states.size());
+
+            size_t i = chunk.begin;
+            while (states.size() > 1 && i < chunk.end) {
+                uint8_t byte = this->input[i++];
+
+                size_t num_runs = 0;
+                for (size_t j = 0; j < states.size(); ++j) {
+                    State next = this->a.next(states[j], byte) & STATE_MASK;
+                    if (next == DFA_REJECT) {
+                        remap[j] = NONE;
+                    } else if (seen[next] == NONE) {
+                        seen[next] = remap[j] = num_runs;
+                        states[num_runs++] = next;
+                    } else {
+                        remap[j] = seen[next];
+                    }
+                }
+
+                for (size_t j = 0; j < num_runs; ++j)
+                    seen[states[j]] = NONE;
+
+                if (num_runs != states.size()) {
+                    states.resize(num_runs);
+                    for (auto& r : run) {
+                        if (r != NONE)
+                            r = remap[r];
+                    }
+                }
+            }
+
+            chunk.converged = i;
+            for (size_t s = 0; s < this->num_states; ++s)
+                chunk.mapping[s] = run[s] == NONE ? DFA_REJECT : states[run[s]];
+
+            if (states.size() == 1) {
+                this->lex_speculatively(chunk, states[0]);
+            } else {
+                // Either every run rejected, or the runs did not converge before the end of the chunk.
+                chunk.speculated = false;
+                chunk.num_speculative_tokens = 0;
+            }
+        }
+
+        void lex_speculatively(Chunk& chunk, State state) const {
+            chunk.speculated = true;
+            chunk.num_speculative_tokens = 0;
+            size_t offset = chunk.converged - chunk.begin;
+            chunk.speculative_result = lex_range(
+                this->a,
+                this->input,
+                chunk.converged,
+                chunk.end,
+                state,
+                chunk.types.get() + offset,
+                chunk.ends.get() + offset,
+                chunk.num_speculative_tokens
+            );
+        }
+
+        // The state after the chunk if it starts in `state`.
+        State result(const Chunk& chunk, State state) const {
+            State converged = chunk.mapping[state & STATE_MASK];
+            return chunk.speculated && converged != DFA_REJECT ? chunk.speculative_result : converged;
+        }
+
+        // Once the prefix state of the chunk is known, lex the bytes before the point of convergence, and
+        // keep the speculatively lexed tokens if the chunk did not reject before that point.
+        void fix_up(Chunk& chunk) const {
+            chunk.num_tokens = 0;
+            State state = lex_range(
+                this->a,
+                this->input,
+                chunk.begin,
+                chunk.converged,
+                chunk.prefix,
+                chunk.types.get(),
+                chunk.ends.get(),
+                chunk.num_tokens
+            );
+
+            if (!chunk.speculated || (state & STATE_MASK) == DFA_REJECT) {
+                chunk.result = state;
+                return;
+            }
+
+            assert((state & STATE_MASK) == (chunk.mapping[chunk.prefix & STATE_MASK] & STATE_MASK));
+
+            // At most one token ends before every byte, so the tokens before the point of convergence never
+            // overlap the speculative tokens. In the first chunk, there are no such tokens.
+            size_t offset = chunk.converged - chunk.begin;
+            if (offset != chunk.num_tokens) {
+                std::copy_n(&chunk.types[offset], chunk.num_speculative_tokens, &chunk.types[chunk.num_tokens]);
+                std::copy_n(&chunk.ends[offset], chunk.num_speculative_tokens, &chunk.ends[chunk.num_tokens]);
+            }
+            chunk.num_tokens += chunk.num_speculative_tokens;
+            chunk.result = chunk.speculative_result;
+        }
+    };
+
+    // Invoke `f(i)` for `i` in [0, n), each on its own thread.
+    template <typename F>
+    void parallel_for(size_t n, F f) {
+        auto workers = std::vector<std::thread>();
+        workers.reserve(n - 1);
+        for (size_t i = 1; i < n; ++i)
+            workers.emplace_back(f, i);
+
+        f(0);
+
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    template <typename S>
+    std::vector<Chunk<S>> split(std::string_view input, unsigned threads) {
+        if (input.size() > std::numeric_limits<int32_t>::max())
+            throw pareas::InputTooLargeError();
+
+        if (threads == 0)
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+        size_t num_chunks = std::clamp<size_t>(input.size() / MIN_CHUNK_SIZE, 1, threads);
+        size_t chunk_size = input.size() / num_chunks;
+        auto chunks = std::vector<Chunk<S>>(num_chunks);
+        for (size_t i = 0; i < num_chunks; ++i) {
+            chunks[i].begin = i * chunk_size;
+            chunks[i].end = i == num_chunks - 1 ? input.size() : chunks[i].begin + chunk_size;
+        }
+
+        return chunks;
+    }
+
+    // Widen an 8-bit state to 16 bits, moving the produces-token flag to the highest bit of the result.
+    uint16_t widen(uint8_t state) {
+        return (state & STATE_MASK<uint8_t>) | (state & PRODUCES_TOKEN_MASK<uint8_t> ? PRODUCES_TOKEN_MASK<uint16_t> : 0);
+    }
+
+    // The initial states, merge table and DFA transitions of `tables` widened to 16 bits, in that order.
+    std::vector<uint16_t> widen_states(const NarrowTables& tables) {
+        size_t num_initial_states = tables.num_byte_classes;
+        size_t num_merges = tables.n * tables.n;
+        size_t num_dfa_transitions = tables.num_dfa_states * tables.num_byte_classes;
+
+        auto states = std::vector<uint16_t>();
+        states.reserve(num_initial_states + num_merges + 1 + num_dfa_transitions);
+
+        std::transform(tables.initial_states, tables.initial_states + num_initial_states, std::back_inserter(states), widen);
+        std::transform(tables.merge_table, tables.merge_table + num_merges, std::back_inserter(states), widen);
+        // The padding element of the merge table.
+        states.push_back(0);
+        std::transform(tables.dfa_transitions, tables.dfa_transitions + num_dfa_transitions, std::back_inserter(states), widen);
+
+        return states;
+    }
+
+    Tables widened_tables(const NarrowTables& tables, const std::vector<uint16_t>& states) {
+        const auto* initial_states = states.data();
+        const auto* merge_table = initial_states + tables.num_byte_classes;
+        const auto* dfa_transitions = merge_table + tables.n * tables.n + 1;
+
+        return {
+            .n = tables.n,
+            .num_byte_classes = tables.num_byte_classes,
+            .byte_classes = tables.byte_classes,
+            .initial_states = initial_states,
+            .merge_table = merge_table,
+            .final_states = tables.final_states,
+            .identity_state = widen(tables.identity_state),
+            .num_dfa_states = tables.num_dfa_states,
+            .dfa_transitions = dfa_transitions,
+            .dfa_final_states = tables.dfa_final_states,
+            .dfa_start_state = widen(tables.dfa_start_state),
+        };
+    }
+
+    bool detect_avx2() {
+        #if defined(PAREAS_HOST_LEXER_AVX2)
+            return __builtin_cpu_supports("avx2");
+        #else
+            return false;
+        #endif
+    }
+
+    // Concatenate the tokens of all chunks, and append the final token, which ends at the end of the input.
+    // If the lexer does not end in an accepting state, this is the invalid token.
+    template <typename S>
+    Tokens collect(const std::vector<Chunk<S>>& chunks, size_t input_size, TokenType final_token) {
+        // Compute where the tokens of every chunk are placed, and the offset at which the first of them starts.
+        auto first_token = std::vector<size_t>(chunks.size());
+        auto first_offset = std::vector<int32_t>(chunks.size());
+        size_t num_tokens = 0;
+        int32_t offset = 0;
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            first_token[i] = num_tokens;
+            first_offset[i] = offset;
+            num_tokens += chunks[i].num_tokens;
+            if (chunks[i].num_tokens > 0)
+                offset = chunks[i].ends[chunks[i].num_tokens - 1];
+        }
+
+        auto tokens = Tokens();
+        tokens.types.resize(num_tokens + 1);
+        tokens.offsets.resize(num_tokens + 1);
+        tokens.lengths.resize(num_tokens + 1);
+
+        parallel_for(chunks.size(), [&](size_t i) {
+            const auto& chunk = chunks[i];
+            size_t token = first_token[i];
+            int32_t start = first_offset[i];
+            std::copy_n(chunk.types.get(), chunk.num_tokens, &tokens.types[token]);
+            for (size_t j = 0; j < chunk.num_tokens; ++j, ++token) {
+                tokens.offsets[token] = start;
+                tokens.lengths[token] = chunk.ends[j] - start;
+                start = chunk.ends[j];
+            }
+        });
+
+        tokens.types[num_tokens] = final_token;
+        tokens.offsets[num_tokens] = offset;
+        tokens.lengths[num_tokens] = input_size - offset;
+
+        return tokens;
+    }
+}
+
+namespace pareas {
+    std::optional<LexerBackend> parse_lexer_backend(std::string_view name) {
+        if (name == "auto")
+            return LexerBackend::AUTO;
+        else if (name == "device")
+            return LexerBackend::DEVICE;
+        else if (name == "host")
+            return LexerBackend::HOST;
+        else if (name == "dfa")
+            return LexerBackend::DFA;
+        return std::nullopt;
+    }
+
+    bool LexerOptions::use_host(size_t input_size) const {
+        switch (this->backend) {
+            case LexerBackend::AUTO: return input_size < this->host_threshold;
+            case LexerBackend::DEVICE: return false;
+            case LexerBackend::HOST: return true;
+            case LexerBackend::DFA: return true;
+        }
+
+        assert(false);
+        return false;
+    }
+
+    template <typename S>
+    HostLexer::Engine<S>::Engine(const BasicTables<S>& tables):
+        tables(tables), dfa_table(tables.num_dfa_states * 256) {
+        for (size_t byte = 0; byte < this->initial_state.size(); ++byte) {
+            this->initial_state[byte] = tables.initial_states[tables.byte_classes[byte]] & STATE_MASK<S>;
+        }
+
+        for (size_t state = 0; state < tables.num_dfa_states; ++state) {
+            for (size_t byte = 0; byte < 256; ++byte) {
+                size_t index = state * tables.num_byte_classes + tables.byte_classes[byte];
+                this->dfa_table[state * 256 + byte] = tables.dfa_transitions[index];
+            }
+        }
+    }
+
+    template <typename S>
+    auto HostLexer::Engine<S>::lex(std::string_view input, unsigned threads, bool use_avx2) const -> Tokens {
+        auto chunks = split<S>(input, threads);
+        if (input.empty())
+            return Tokens();
+
+        auto cl = ChunkLexer<S>{
+            .a = {
+                .tables = this->tables,
+                .initial_state = this->initial_state.data(),
+            },
+            .input = reinterpret_cast<const uint8_t*>(input.data()),
+            .use_avx2 = use_avx2,
+        };
+
+        // Compute the state in which every chunk starts. With a single chunk, this is simply the identity.
+        auto state = this->tables.identity_state;
+        if (chunks.size() > 1)
+            parallel_for(chunks.size(), [&](size_t i) { cl.summarize(chunks[i]); });
+
+        for (auto& chunk : chunks) {
+            chunk.prefix = state;
+            if (chunks.size() > 1)
+                state = cl.merge(state, chunk.summary & STATE_MASK<S>);
+        }
+
+        parallel_for(chunks.size(), [&](size_t i) { cl.emit(chunks[i]); });
+
+        return collect(chunks, input.size(), cl.a.token(chunks.back().result));
+    }
+
+    template <typename S>
+    auto HostLexer::Engine<S>::lex_dfa(std::string_view input, unsigned threads) const -> Tokens {
+        auto chunks = split<S>(input, threads);
+        if (input.empty())
+            return Tokens();
+
+        auto dl = DfaLexer<S>{
+            .a = {
+                .table = this->dfa_table.data(),
+                .final_states = this->tables.dfa_final_states,
+            },
+            .input = reinterpret_cast<const uint8_t*>(input.data()),
+            .num_states = this->tables.num_dfa_states,
+            .start_state = this->tables.dfa_start_state,
+        };
+
+        parallel_for(chunks.size(), [&](size_t i) { dl.speculate(chunks[i]); });
+
+        auto state = this->tables.dfa_start_state;
+        for (auto& chunk : chunks) {
+            chunk.prefix = state;
+            state = dl.result(chunk, state);
+        }
+
+        parallel_for(chunks.size(), [&](size_t i) { dl.fix_up(chunks[i]); });
+
+        return collect(chunks, input.size(), dl.a.token(chunks.back().result));
+    }
+
+    HostLexer::HostLexer(const NarrowTables& tables):
+        widened_states(widen_states(tables)),
+        engine(std::in_place_type<Engine<uint16_t>>, widened_tables(tables, this->widened_states)),
+        use_avx2(detect_avx2()) {
+    }
+
+    HostLexer::HostLexer(const Tables& tables):
+        engine(std::in_place_type<Engine<uint16_t>>, tables), use_avx2(detect_avx2()) {
+    }
+
+    HostLexer::HostLexer(const WideTables& tables):
+        engine(std::in_place_type<Engine<uint32_t>>, tables), use_avx2(detect_avx2()) {
+    }
+
+    auto HostLexer::lex(std::string_view input, unsigned threads) const -> Tokens {
+        return std::visit([&](const auto& engine) { return engine.lex(input, threads, this->use_avx2); }, this->engine);
+    }
+
+    auto HostLexer::lex_dfa(std::string_view input, unsigned threads) const -> Tokens {
+        return std::visit([&](const auto& engine) { return engine.lex_dfa(input, threads); }, this->engine);
+    }
+
+    auto HostLexer::lex(std::string_view input, const LexerOptions& opts) const -> Tokens {
+        // Unlike the merge table lexer, the DFA lexer usually only makes a single pass over the input, so
+        // prefer it unless the merge table lexer is explicitly requested.
+        if (opts.backend == LexerBackend::HOST)
+            return this->lex(input, opts.host_threads);
+        return this->lex_dfa(input, opts.host_threads);
+    }
+}
@@ -0,0 +1,143 @@
+#include "pareas/common/input_file.hpp"
+
+#include <fmt/format.h>
+
+#include <system_error>
+#include <utility>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    constexpr const size_t READ_CHUNK_SIZE = 1 << 16;
+
+    [[noreturn]]
+    void throw_errno(const char* what, const char* path) {
+        throw std::system_error(errno, std::generic_category(), fmt::format("Failed to {} input file '{}'", what, path));
+    }
+
+    struct FileDescriptor {
+        int fd;
+
+        ~FileDescriptor() {
+            if (this->fd > STDIN_FILENO)
+                close(this->fd);
+        }
+    };
+}
+
+namespace pareas {
+    InputFile::InputFile(const char* path):
+        data(nullptr), size(0), mapped(false) {
+        auto file = FileDescriptor{std::strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY | O_CLOEXEC)};
+        if (file.fd < 0)
+            throw_errno("open", path);
+
+        struct stat st;
+        if (fstat(file.fd, &st) < 0)
+            throw_errno("stat", path);
+
+        // Some files (in /proc or /sys for example) report a size of zero despite having content, so those are
+        // always read.
+        if (S_ISREG(st.st_mode) && st.st_size > 0) {
+            int flags = MAP_PRIVATE;
+            #if defined(MAP_POPULATE)
+                // Fault in the pages now, so that the cost of reading the file is accounted to
+                // reading rather than to the first consumer of the data.
+                flags |= MAP_POPULATE;
+            #endif
+
+            void* addr = mmap(nullptr, st.st_size, PROT_READ, flags, file.fd, 0);
+            if (addr != MAP_FAILED) {
+                madvise(addr, st.st_size, MADV_SEQUENTIAL);
+                this->data = static_cast<const char*>(addr);
+                this->size = st.st_size;
+                this->mapped = true;
+                return;
+            }
+
+            // Some file systems do not support mapping, fall back to reading in that case.
+        }
+
+        // Read the file in chunks, growing the buffer geometrically. For regular files the size is
+        // known up front, which saves the reallocations. The extra byte leaves room for the read that
+        // finds the end of the file.
+        size_t capacity = S_ISREG(st.st_mode) && st.st_size > 0 ? st.st_size + 1 : READ_CHUNK_SIZE;
+        this->buffer = std::make_unique<char[]>(capacity);
+
+        while (true) {
+            if (this->size == capacity) {
+                auto new_buffer = std::make_unique<char[]>(capacity * 2);
+                std::memcpy(new_buffer.get(), this->buffer.get(), this->size);
+                this->buffer = std::move(new_buffer);
+                capacity *= 2;
+            }
+
+            ssize_t n = read(file.fd, this->buffer.get() + this->size, capacity - this->size);
+            if (n < 0 && errno == EINTR)
+                continue;
+            else if (n < 0)
+                throw_errno("read", path);
+            else if (n == 0)
+                break;
+
+            this->size += n;
+        }
+
+        this->data = this->buffer.get();
+    }
+
+    InputFile::InputFile(InputFile&& other):
+        data(std::exchange(other.data, nullptr)),
+        size(std::exchange(other.size, 0)),
+        mapped(std::exchange(other.mapped, false)),
+        buffer(std::move(other.buffer)) {
+    }
+
+    InputFile& InputFile::operator=(InputFile&& other) {
+        std::swap(this->data, other.data);
+        std::swap(this->size, other.size);
+        std::swap(this->mapped, other.mapped);
+        std::swap(this->buffer, other.buffer);
+        return *this;
+    }
+
+    InputFile::~InputFile() {
+        if (this->mapped)
+            munmap(const_cast<char*>(this->data), this->size);
+    }
+
+    InputStream::InputStream(const char* path):
+        fd(std::strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY | O_CLOEXEC)), path(path) {
+        if (this->fd < 0)
+            throw_errno("open", path);
+
+        posix_fadvise(this->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    InputStream::~InputStream() {
+        if (this->fd > STDIN_FILENO)
+            close(this->fd);
+    }
+
+    size_t InputStream::read(char* buffer, size_t size) {
+        size_t total = 0;
+        while (total < size) {
+            ssize_t n = ::read(this->fd, buffer + total, size - total);
+            if (n < 0 && errno == EINTR)
+                continue;
+            else if (n < 0)
+                throw_errno("read", this->path.c_str());
+            else if (n == 0)
+                break;
+
+            total += n;
+        }
+
+        return total;
+    }
+}
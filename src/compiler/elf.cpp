@@ -0,0 +1,294 @@
+#include "pareas/compiler/elf.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <system_error>
+#include <stdexcept>
+#include <limits>
+#include <cstring>
+#include <cerrno>
+
+#include <elf.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <limits.h>
+
+#ifndef EM_RISCV
+    #define EM_RISCV 243
+#endif
+
+#ifndef EF_RISCV_FLOAT_ABI_SINGLE
+    #define EF_RISCV_FLOAT_ABI_SINGLE 0x0002
+#endif
+
+namespace {
+    // Virtual address at which executables are loaded. This is the default of the GNU linker for RISC-V.
+    constexpr const uint64_t EXECUTABLE_BASE = 0x10000;
+    constexpr const uint64_t PAGE_SIZE = 0x1000;
+    constexpr const uint64_t INSTR_SIZE = sizeof(uint32_t);
+    constexpr const uint64_t START_STUB_INSTRS = 4;
+
+    // Section indices, in order of appearance in the section header table.
+    enum Section : uint16_t {
+        SECTION_NULL,
+        SECTION_TEXT,
+        SECTION_SYMTAB,
+        SECTION_STRTAB,
+        SECTION_SHSTRTAB,
+        NUM_SECTIONS,
+    };
+
+    struct Elf32 {
+        using Ehdr = Elf32_Ehdr;
+        using Phdr = Elf32_Phdr;
+        using Shdr = Elf32_Shdr;
+        using Sym = Elf32_Sym;
+        constexpr static const unsigned char ident_class = ELFCLASS32;
+    };
+
+    struct Elf64 {
+        using Ehdr = Elf64_Ehdr;
+        using Phdr = Elf64_Phdr;
+        using Shdr = Elf64_Shdr;
+        using Sym = Elf64_Sym;
+        constexpr static const unsigned char ident_class = ELFCLASS64;
+    };
+
+    uint64_t align(uint64_t offset, uint64_t alignment) {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    // Startup stub for executables: call the entry function, and pass its return value to the exit syscall.
+    std::vector<uint32_t> make_start_stub(uint64_t entry_offset) {
+        // The call is performed by auipc + jalr, the offset is relative to the auipc.
+        auto offset = static_cast<int64_t>(entry_offset);
+        auto hi = static_cast<uint32_t>((offset + 0x800) >> 12);
+        auto lo = static_cast<uint32_t>(offset - (static_cast<int64_t>(hi) << 12));
+
+        return {
+            (hi << 12) | (1 << 7) | 0b0010111, // auipc ra, %hi(entry)
+            ((lo & 0xFFF) << 20) | (1 << 15) | (1 << 7) | 0b1100111, // jalr ra, %lo(entry)(ra)
+            (93 << 20) | (17 << 7) | 0b0010011, // addi a7, zero, 93 (exit)
+            0b1110011, // ecall
+        };
+    }
+
+    void write_all(int fd, std::vector<iovec>& iov) {
+        auto* it = iov.data();
+        auto* end = iov.data() + iov.size();
+
+        while (it != end) {
+            int count = std::min<ptrdiff_t>(end - it, IOV_MAX);
+            ssize_t n = writev(fd, it, count);
+            if (n < 0 && errno == EINTR)
+                continue;
+            else if (n < 0)
+                throw std::system_error(errno, std::generic_category(), "Failed to write output");
+
+            // Skip over everything that was written, in case of a partial write.
+            size_t written = n;
+            while (it != end && written >= it->iov_len) {
+                written -= it->iov_len;
+                ++it;
+            }
+
+            if (it != end) {
+                it->iov_base = static_cast<char*>(it->iov_base) + written;
+                it->iov_len -= written;
+            }
+        }
+    }
+
+    template <typename Elf>
+    void write_elf(int fd, const HostModule& mod, const elf::Options& opts) {
+        using Ehdr = typename Elf::Ehdr;
+        using Phdr = typename Elf::Phdr;
+        using Shdr = typename Elf::Shdr;
+        using Sym = typename Elf::Sym;
+
+        bool executable = opts.type == elf::FileType::EXECUTABLE;
+
+        auto stub = std::vector<uint32_t>();
+        if (executable) {
+            size_t entry = 0;
+            while (entry < mod.num_functions && mod.func_id[entry] != opts.entry_function)
+                ++entry;
+
+            if (entry == mod.num_functions)
+                throw std::runtime_error(fmt::format("Entry function {} does not exist", opts.entry_function));
+
+            // The stub is placed in front of the module, the call is made from the first instruction.
+            stub = make_start_stub((START_STUB_INSTRS + mod.func_start[entry]) * INSTR_SIZE);
+        }
+
+        uint64_t stub_size = stub.size() * INSTR_SIZE;
+        uint64_t text_size = stub_size + mod.num_instructions * INSTR_SIZE;
+
+        if (text_size > std::numeric_limits<decltype(Shdr::sh_size)>::max())
+            throw std::runtime_error("Module too large for ELF class");
+
+        // Names
+        auto strtab = std::string(1, '\0');
+        auto shstrtab = std::string(1, '\0');
+
+        auto add_name = [](std::string& tab, std::string_view name) {
+            auto offset = tab.size();
+            tab += name;
+            tab.push_back('\0');
+            return static_cast<uint32_t>(offset);
+        };
+
+        uint32_t text_name = add_name(shstrtab, ".text");
+        uint32_t symtab_name = add_name(shstrtab, ".symtab");
+        uint32_t strtab_name = add_name(shstrtab, ".strtab");
+        uint32_t shstrtab_name = add_name(shstrtab, ".shstrtab");
+
+        // Layout
+        uint64_t phdrs_offset = sizeof(Ehdr);
+        uint64_t num_phdrs = executable ? 1 : 0;
+        uint64_t text_offset = align(phdrs_offset + num_phdrs * sizeof(Phdr), 16);
+        uint64_t text_address = executable ? EXECUTABLE_BASE + text_offset : 0;
+
+        // Symbols: The null symbol and the section symbol are local, and must come first.
+        auto symbols = std::vector<Sym>(2);
+        symbols[1].st_info = ELF32_ST_INFO(STB_LOCAL, STT_SECTION);
+        symbols[1].st_shndx = SECTION_TEXT;
+        uint32_t first_global = symbols.size();
+
+        if (executable) {
+            auto& sym = symbols.emplace_back();
+            sym.st_name = add_name(strtab, "_start");
+            sym.st_value = text_address;
+            sym.st_size = stub_size;
+            sym.st_info = ELF32_ST_INFO(STB_GLOBAL, STT_FUNC);
+            sym.st_shndx = SECTION_TEXT;
+        }
+
+        for (size_t i = 0; i < mod.num_functions; ++i) {
+            auto& sym = symbols.emplace_back();
+            sym.st_name = add_name(strtab, fmt::format("fn{}", mod.func_id[i]));
+            sym.st_value = text_address + stub_size + mod.func_start[i] * INSTR_SIZE;
+            sym.st_size = mod.func_size[i] * INSTR_SIZE;
+            sym.st_info = ELF32_ST_INFO(STB_GLOBAL, STT_FUNC);
+            sym.st_shndx = SECTION_TEXT;
+        }
+
+        uint64_t symtab_offset = align(text_offset + text_size, alignof(Sym));
+        uint64_t symtab_size = symbols.size() * sizeof(Sym);
+        uint64_t strtab_offset = symtab_offset + symtab_size;
+        uint64_t shstrtab_offset = strtab_offset + strtab.size();
+        uint64_t shdrs_offset = align(shstrtab_offset + shstrtab.size(), alignof(Shdr));
+
+        // Headers
+        auto ehdr = Ehdr{};
+        std::memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+        ehdr.e_ident[EI_CLASS] = Elf::ident_class;
+        ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+        ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+        ehdr.e_ident[EI_OSABI] = ELFOSABI_NONE;
+        ehdr.e_type = executable ? ET_EXEC : ET_REL;
+        ehdr.e_machine = EM_RISCV;
+        ehdr.e_version = EV_CURRENT;
+        ehdr.e_entry = executable ? text_address : 0;
+        ehdr.e_phoff = executable ? phdrs_offset : 0;
+        ehdr.e_shoff = shdrs_offset;
+        // Float arguments and return values are passed in the floating point registers.
+        ehdr.e_flags = EF_RISCV_FLOAT_ABI_SINGLE;
+        ehdr.e_ehsize = sizeof(Ehdr);
+        ehdr.e_phentsize = executable ? sizeof(Phdr) : 0;
+        ehdr.e_phnum = num_phdrs;
+        ehdr.e_shentsize = sizeof(Shdr);
+        ehdr.e_shnum = NUM_SECTIONS;
+        ehdr.e_shstrndx = SECTION_SHSTRTAB;
+
+        // The single load segment maps everything from the start of the file up to the end of the code.
+        auto phdr = Phdr{};
+        phdr.p_type = PT_LOAD;
+        phdr.p_offset = 0;
+        phdr.p_vaddr = EXECUTABLE_BASE;
+        phdr.p_paddr = EXECUTABLE_BASE;
+        phdr.p_filesz = text_offset + text_size;
+        phdr.p_memsz = text_offset + text_size;
+        phdr.p_flags = PF_R | PF_X;
+        phdr.p_align = PAGE_SIZE;
+
+        auto shdrs = std::vector<Shdr>(NUM_SECTIONS);
+
+        auto& text = shdrs[SECTION_TEXT];
+        text.sh_name = text_name;
+        text.sh_type = SHT_PROGBITS;
+        text.sh_flags = SHF_ALLOC | SHF_EXECINSTR;
+        text.sh_addr = text_address;
+        text.sh_offset = text_offset;
+        text.sh_size = text_size;
+        text.sh_addralign = INSTR_SIZE;
+
+        auto& symtab = shdrs[SECTION_SYMTAB];
+        symtab.sh_name = symtab_name;
+        symtab.sh_type = SHT_SYMTAB;
+        symtab.sh_offset = symtab_offset;
+        symtab.sh_size = symtab_size;
+        symtab.sh_link = SECTION_STRTAB;
+        symtab.sh_info = first_global;
+        symtab.sh_addralign = alignof(Sym);
+        symtab.sh_entsize = sizeof(Sym);
+
+        auto& strtab_hdr = shdrs[SECTION_STRTAB];
+        strtab_hdr.sh_name = strtab_name;
+        strtab_hdr.sh_type = SHT_STRTAB;
+        strtab_hdr.sh_offset = strtab_offset;
+        strtab_hdr.sh_size = strtab.size();
+        strtab_hdr.sh_addralign = 1;
+
+        auto& shstrtab_hdr = shdrs[SECTION_SHSTRTAB];
+        shstrtab_hdr.sh_name = shstrtab_name;
+        shstrtab_hdr.sh_type = SHT_STRTAB;
+        shstrtab_hdr.sh_offset = shstrtab_offset;
+        shstrtab_hdr.sh_size = shstrtab.size();
+        shstrtab_hdr.sh_addralign = 1;
+
+        // Gather everything, and write it out in one go.
+        static const char padding[16] = {};
+        uint64_t offset = 0;
+        auto iov = std::vector<iovec>();
+
+        auto append = [&](uint64_t at, const void* data, size_t size) {
+            if (at > offset)
+                iov.push_back({const_cast<char*>(padding), at - offset});
+            if (size > 0)
+                iov.push_back({const_cast<void*>(data), size});
+            offset = at + size;
+        };
+
+        append(0, &ehdr, sizeof(Ehdr));
+        if (executable)
+            append(phdrs_offset, &phdr, sizeof(Phdr));
+        append(text_offset, stub.data(), stub_size);
+        append(offset, mod.instructions.get(), mod.num_instructions * INSTR_SIZE);
+        append(symtab_offset, symbols.data(), symtab_size);
+        append(strtab_offset, strtab.data(), strtab.size());
+        append(shstrtab_offset, shstrtab.data(), shstrtab.size());
+        append(shdrs_offset, shdrs.data(), shdrs.size() * sizeof(Shdr));
+
+        write_all(fd, iov);
+    }
+}
+
+namespace elf {
+    void write(int fd, const HostModule& mod, const Options& opts) {
+        static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "ELF writer assumes a little endian host");
+
+        switch (opts.elf_class) {
+            case Class::ELF32:
+                write_elf<Elf32>(fd, mod, opts);
+                break;
+            case Class::ELF64:
+                write_elf<Elf64>(fd, mod, opts);
+                break;
+        }
+    }
+}
@@ -10,13 +10,19 @@
 
 namespace {
     futhark::UniqueLexTable upload_lex_table(futhark_context* ctx) {
-        auto initial_state = futhark::UniqueArray<uint16_t, 1>(
+        auto byte_class = futhark::UniqueArray<uint8_t, 1>(
+            ctx,
+            reinterpret_cast<const grammar::LexTable::ByteClass*>(grammar::lex_table.byte_classes),
+            grammar::LexTable::NUM_BYTES
+        );
+
+        auto initial_state = futhark::UniqueArray<grammar::LexTable::State, 1>(
             ctx,
             reinterpret_cast<const grammar::LexTable::State*>(grammar::lex_table.initial_states),
-            grammar::LexTable::NUM_INITIAL_STATES
+            grammar::lex_table.num_byte_classes
         );
 
-        auto merge_table = futhark::UniqueArray<uint16_t, 2>(
+        auto merge_table = futhark::UniqueArray<grammar::LexTable::State, 2>(
             ctx,
             reinterpret_cast<const grammar::LexTable::State*>(grammar::lex_table.merge_table),
             grammar::lex_table.n,
@@ -34,6 +40,7 @@ namespace {
         int err = futhark_entry_mk_lex_table(
             ctx,
             &lex_table,
+            byte_class.get(),
             initial_state.get(),
             merge_table.get(),
             final_state.get()
@@ -45,6 +52,24 @@ namespace {
         return lex_table;
     }
 
+    pareas::HostLexer::BasicTables<grammar::LexTable::State> host_lex_tables() {
+        static_assert(sizeof(grammar::Token) == sizeof(pareas::HostLexer::TokenType));
+
+        return {
+            .n = grammar::lex_table.n,
+            .num_byte_classes = grammar::lex_table.num_byte_classes,
+            .byte_classes = grammar::lex_table.byte_classes,
+            .initial_states = grammar::lex_table.initial_states,
+            .merge_table = grammar::lex_table.merge_table,
+            .final_states = reinterpret_cast<const pareas::HostLexer::TokenType*>(grammar::lex_table.final_states),
+            .identity_state = grammar::lex_table.identity_state,
+            .num_dfa_states = grammar::lex_table.num_dfa_states,
+            .dfa_transitions = grammar::lex_table.dfa_transitions,
+            .dfa_final_states = reinterpret_cast<const pareas::HostLexer::TokenType*>(grammar::lex_table.dfa_final_states),
+            .dfa_start_state = grammar::lex_table.dfa_start_state,
+        };
+    }
+
     template <typename T, typename U, typename F>
     T upload_strtab(futhark_context* ctx, const grammar::StrTab<U>& strtab, F upload_fn) {
         static_assert(sizeof(U) == sizeof(uint8_t));
@@ -66,6 +91,22 @@ namespace {
 
         return tab;
     }
+
+    // Like `Profiler::measure`, but also count the device arrays that are released while `f` runs. In most passes,
+    // these are the inputs that were replaced by the outputs of its entry point.
+    template <typename F>
+    void measure_pass(pareas::Profiler& p, const char* name, F f) {
+        p.measure(name, [&]{
+            auto before = futhark::release_counters;
+            f();
+
+            auto arrays = futhark::release_counters.arrays - before.arrays;
+            if (arrays > 0) {
+                p.count("released arrays", arrays);
+                p.count("released bytes", futhark::release_counters.bytes - before.bytes);
+            }
+        });
+    }
 }
 
 namespace frontend {
@@ -86,7 +127,34 @@ namespace frontend {
         }
     }
 
-    DeviceAst compile(futhark_context* ctx, const std::string& input, bool verbose_tree, pareas::Profiler& p, std::FILE* debug_log) {
+    GrammarTables upload_tables(futhark_context* ctx) {
+        return GrammarTables{
+            .host_lexer = pareas::HostLexer(host_lex_tables()),
+            .lex_table = upload_lex_table(ctx),
+            .stack_change_table = upload_strtab<futhark::UniqueStackChangeTable>(
+                ctx,
+                grammar::stack_change_table,
+                futhark_entry_mk_stack_change_table
+            ),
+            .parse_table = upload_strtab<futhark::UniqueParseTable>(
+                ctx,
+                grammar::parse_table,
+                futhark_entry_mk_parse_table
+            ),
+            .arities = futhark::UniqueArray<int32_t, 1>(ctx, grammar::arities, grammar::NUM_PRODUCTIONS),
+        };
+    }
+
+    DeviceAst compile(
+        futhark_context* ctx,
+        const GrammarTables& tables,
+        std::string_view input,
+        const pareas::LexerOptions& lexer_opts,
+        bool fused,
+        bool verbose_tree,
+        pareas::Profiler& p,
+        std::FILE* debug_log
+    ) {
         auto debug_log_region = [&](const char* name) {
             if (debug_log)
                 fmt::print(debug_log, "<<<{}>>>\n", name);
@@ -94,38 +162,38 @@ namespace frontend {
 
         debug_log_region("upload");
         p.begin();
-        p.begin();
-        auto lex_table = upload_lex_table(ctx);
-        auto sct = upload_strtab<futhark::UniqueStackChangeTable>(
-            ctx,
-            grammar::stack_change_table,
-            futhark_entry_mk_stack_change_table
-        );
-
-        auto pt = upload_strtab<futhark::UniqueParseTable>(
-            ctx,
-            grammar::parse_table,
-            futhark_entry_mk_parse_table
-        );
-
-        auto arity_array = futhark::UniqueArray<int32_t, 1>(ctx, grammar::arities, grammar::NUM_PRODUCTIONS);
-        p.end("table");
-        p.begin();
-
         auto input_array = futhark::UniqueArray<uint8_t, 1>(ctx, reinterpret_cast<const uint8_t*>(input.data()), input.size());
-        p.end("input");
+        p.count("bytes", input.size());
         p.end("upload");
 
         p.begin();
 
         debug_log_region("tokenize");
         auto tokens = futhark::UniqueTokenArray(ctx);
-        p.measure("tokenize", [&]{
-            int err = futhark_entry_frontend_tokenize(ctx, &tokens, input_array, lex_table);
-            if (err)
-                throw futhark::Error(ctx);
-        });
-        lex_table.clear();
+        if (lexer_opts.use_host(input.size())) {
+            measure_pass(p, "tokenize", [&]{
+                p.begin();
+                auto host_tokens = tables.host_lexer.lex(input, lexer_opts);
+                p.count("tokens", host_tokens.size());
+                p.end("host lex");
+
+                p.begin();
+                auto types = futhark::UniqueArray<uint8_t, 1>(ctx, host_tokens.types.data(), host_tokens.size());
+                auto offsets = futhark::UniqueArray<int32_t, 1>(ctx, host_tokens.offsets.data(), host_tokens.size());
+                auto lengths = futhark::UniqueArray<int32_t, 1>(ctx, host_tokens.lengths.data(), host_tokens.size());
+                p.end("token upload");
+
+                int err = futhark_entry_frontend_tokenize_host(ctx, &tokens, types, offsets, lengths);
+                if (err)
+                    throw futhark::Error(ctx);
+            });
+        } else {
+            measure_pass(p, "tokenize", [&]{
+                int err = futhark_entry_frontend_tokenize(ctx, &tokens, input_array, tables.lex_table);
+                if (err)
+                    throw futhark::Error(ctx);
+            });
+        }
 
         if (verbose_tree) {
             int32_t result;
@@ -135,16 +203,15 @@ namespace frontend {
 
         debug_log_region("parse");
         auto node_types = futhark::UniqueArray<uint8_t, 1>(ctx);
-        p.measure("parse", [&]{
+        measure_pass(p, "parse", [&]{
             bool valid = false;
-            int err = futhark_entry_frontend_parse(ctx, &valid, &node_types, tokens, sct, pt);
+            int err = futhark_entry_frontend_parse(ctx, &valid, &node_types, tokens, tables.stack_change_table, tables.parse_table);
             if (err)
                 throw futhark::Error(ctx);
             if (!valid)
                 throw CompileError(Error::PARSE_ERROR);
+            p.count("nodes", node_types.shape()[0]);
         });
-        sct.clear();
-        pt.clear();
 
         if (verbose_tree) {
             fmt::print(std::cerr, "Initial nodes: {}\n", node_types.shape()[0]);
@@ -152,122 +219,132 @@ namespace frontend {
 
         debug_log_region("build parse tree");
         auto parents = futhark::UniqueArray<int32_t, 1>(ctx);
-        p.measure("build parse tree", [&]{
-            int err = futhark_entry_frontend_build_parse_tree(ctx, &parents, node_types, arity_array);
+        measure_pass(p, "build parse tree", [&]{
+            int err = futhark_entry_frontend_build_parse_tree(ctx, &parents, node_types, tables.arities);
             if (err)
                 throw futhark::Error(ctx);
         });
-        arity_array.clear();
-
 
         p.begin();
         debug_log_region("syntax");
-        p.measure("fix bin ops", [&]{
-            auto old_node_types = std::move(node_types);
-            auto old_parents = std::move(parents);
-            int err = futhark_entry_frontend_fix_bin_ops(ctx, &node_types, &parents, old_node_types, old_parents);
-            if (err)
-                throw futhark::Error(ctx);
-        });
-
-        if (verbose_tree) {
-            fmt::print(std::cerr, "Nodes after fix bin ops: {}\n", node_types.shape()[0]);
-        }
-
-        p.measure("fix conditionals", [&]{
-            auto old_node_types = std::move(node_types);
-            auto old_parents = std::move(parents);
-            bool valid;
-            int err = futhark_entry_frontend_fix_if_else(ctx, &valid, &node_types, &parents, old_node_types, old_parents);
-            if (err)
-                throw futhark::Error(ctx);
-            if (!valid)
-                throw CompileError(Error::STRAY_ELSE_ERROR);
-        });
-
-        p.measure("flatten lists", [&]{
-            auto old_node_types = std::move(node_types);
-            auto old_parents = std::move(parents);
-            int err = futhark_entry_frontend_flatten_lists(ctx, &node_types, &parents, old_node_types, old_parents);
-            if (err)
-                throw futhark::Error(ctx);
-        });
-
-        p.measure("fix names", [&]{
-            auto old_node_types = std::move(node_types);
-            auto old_parents = std::move(parents);
-            bool valid;
-            int err = futhark_entry_frontend_fix_names(ctx, &valid, &node_types, &parents, old_node_types, old_parents);
-            if (err)
-                throw futhark::Error(ctx);
-            if (!valid)
-                throw CompileError(Error::INVALID_DECL);
-        });
-
-        p.measure("fix ascriptions", [&]{
-            auto old_parents = std::move(parents);
-            int err = futhark_entry_frontend_fix_ascriptions(ctx, &parents, node_types, old_parents);
-            if (err)
-                throw futhark::Error(ctx);
-        });
-
-        p.measure("fix fn decls", [&]{
-            auto old_parents = std::move(parents);
-            bool valid;
-            int err = futhark_entry_frontend_fix_fn_decls(ctx, &valid, &parents, node_types, old_parents);
-            if (err)
-                throw futhark::Error(ctx);
-            if (!valid)
-                throw CompileError(Error::INVALID_FN_PROTO);
-        });
-
-        p.measure("fix args and params", [&]{
-            auto old_node_types = std::move(node_types);
-            int err = futhark_entry_frontend_fix_args_and_params(ctx, &node_types, old_node_types, parents);
-            if (err)
-                throw futhark::Error(ctx);
-        });
-
-        p.measure("fix decls", [&]{
-            auto old_node_types = std::move(node_types);
-            auto old_parents = std::move(parents);
-            bool valid;
-            int err = futhark_entry_frontend_fix_decls(ctx, &valid, &node_types, &parents, old_node_types, old_parents);
-            if (err)
-                throw futhark::Error(ctx);
-            if (!valid)
-                throw CompileError(Error::INVALID_DECL);
-        });
-
-        p.measure("remove marker nodes", [&]{
-            auto old_parents = std::move(parents);
-            int err = futhark_entry_frontend_remove_marker_nodes(ctx, &parents, node_types, old_parents);
-            if (err)
-                throw futhark::Error(ctx);
-        });
-
         auto prev_siblings = futhark::UniqueArray<int32_t, 1>(ctx);
-        p.measure("compute prev siblings", [&]{
-            auto old_node_types = std::move(node_types);
-            auto old_parents = std::move(parents);
-            int err = futhark_entry_frontend_compute_prev_sibling(ctx, &node_types, &parents, &prev_siblings, old_node_types, old_parents);
-            if (err)
-                throw futhark::Error(ctx);
-        });
-
-        p.measure("check assignments", [&]{
-            bool valid;
-            int err = futhark_entry_frontend_check_assignments(ctx, &valid, node_types, parents, prev_siblings);
-            if (err)
-                throw futhark::Error(ctx);
-            if (!valid)
-                throw CompileError(Error::INVALID_ASSIGN);
-        });
+        if (fused) {
+            measure_pass(p, "fused syntax", [&]{
+                auto old_node_types = std::move(node_types);
+                auto old_parents = std::move(parents);
+                uint8_t error;
+                int err = futhark_entry_frontend_syntax(ctx, &error, &node_types, &parents, &prev_siblings, old_node_types, old_parents);
+                if (err)
+                    throw futhark::Error(ctx);
+                if (error)
+                    throw CompileError(static_cast<Error>(error));
+            });
+        } else {
+            measure_pass(p, "fix bin ops", [&]{
+                auto old_node_types = std::move(node_types);
+                auto old_parents = std::move(parents);
+                int err = futhark_entry_frontend_fix_bin_ops(ctx, &node_types, &parents, old_node_types, old_parents);
+                if (err)
+                    throw futhark::Error(ctx);
+            });
+
+            if (verbose_tree) {
+                fmt::print(std::cerr, "Nodes after fix bin ops: {}\n", node_types.shape()[0]);
+            }
+
+            measure_pass(p, "fix conditionals", [&]{
+                auto old_node_types = std::move(node_types);
+                auto old_parents = std::move(parents);
+                bool valid;
+                int err = futhark_entry_frontend_fix_if_else(ctx, &valid, &node_types, &parents, old_node_types, old_parents);
+                if (err)
+                    throw futhark::Error(ctx);
+                if (!valid)
+                    throw CompileError(Error::STRAY_ELSE_ERROR);
+            });
+
+            measure_pass(p, "flatten lists", [&]{
+                auto old_node_types = std::move(node_types);
+                auto old_parents = std::move(parents);
+                int err = futhark_entry_frontend_flatten_lists(ctx, &node_types, &parents, old_node_types, old_parents);
+                if (err)
+                    throw futhark::Error(ctx);
+            });
+
+            measure_pass(p, "fix names", [&]{
+                auto old_node_types = std::move(node_types);
+                auto old_parents = std::move(parents);
+                bool valid;
+                int err = futhark_entry_frontend_fix_names(ctx, &valid, &node_types, &parents, old_node_types, old_parents);
+                if (err)
+                    throw futhark::Error(ctx);
+                if (!valid)
+                    throw CompileError(Error::INVALID_DECL);
+            });
+
+            measure_pass(p, "fix ascriptions", [&]{
+                auto old_parents = std::move(parents);
+                int err = futhark_entry_frontend_fix_ascriptions(ctx, &parents, node_types, old_parents);
+                if (err)
+                    throw futhark::Error(ctx);
+            });
+
+            measure_pass(p, "fix fn decls", [&]{
+                auto old_parents = std::move(parents);
+                bool valid;
+                int err = futhark_entry_frontend_fix_fn_decls(ctx, &valid, &parents, node_types, old_parents);
+                if (err)
+                    throw futhark::Error(ctx);
+                if (!valid)
+                    throw CompileError(Error::INVALID_FN_PROTO);
+            });
+
+            measure_pass(p, "fix args and params", [&]{
+                auto old_node_types = std::move(node_types);
+                int err = futhark_entry_frontend_fix_args_and_params(ctx, &node_types, old_node_types, parents);
+                if (err)
+                    throw futhark::Error(ctx);
+            });
+
+            measure_pass(p, "fix decls", [&]{
+                auto old_node_types = std::move(node_types);
+                auto old_parents = std::move(parents);
+                bool valid;
+                int err = futhark_entry_frontend_fix_decls(ctx, &valid, &node_types, &parents, old_node_types, old_parents);
+                if (err)
+                    throw futhark::Error(ctx);
+                if (!valid)
+                    throw CompileError(Error::INVALID_DECL);
+            });
+
+            measure_pass(p, "remove marker nodes", [&]{
+                auto old_parents = std::move(parents);
+                int err = futhark_entry_frontend_remove_marker_nodes(ctx, &parents, node_types, old_parents);
+                if (err)
+                    throw futhark::Error(ctx);
+            });
+            measure_pass(p, "compute prev siblings", [&]{
+                auto old_node_types = std::move(node_types);
+                auto old_parents = std::move(parents);
+                int err = futhark_entry_frontend_compute_prev_sibling(ctx, &node_types, &parents, &prev_siblings, old_node_types, old_parents);
+                if (err)
+                    throw futhark::Error(ctx);
+            });
+
+            measure_pass(p, "check assignments", [&]{
+                bool valid;
+                int err = futhark_entry_frontend_check_assignments(ctx, &valid, node_types, parents, prev_siblings);
+                if (err)
+                    throw futhark::Error(ctx);
+                if (!valid)
+                    throw CompileError(Error::INVALID_ASSIGN);
+            });
+        }
         p.end("syntax");
 
         p.begin();
         debug_log_region("sema");
-        p.measure("insert derefs", [&]{
+        measure_pass(p, "insert derefs", [&]{
             auto old_node_types = std::move(node_types);
             auto old_parents = std::move(parents);
             auto old_prev_siblings = std::move(prev_siblings);
@@ -277,7 +354,7 @@ namespace frontend {
         });
 
         auto node_data = futhark::UniqueArray<uint32_t, 1>(ctx);
-        p.measure("extract lexemes", [&]{
+        measure_pass(p, "extract lexemes", [&]{
             int err = futhark_entry_frontend_extract_lexemes(ctx, &node_data, input_array, tokens, node_types);
             if (err)
                 throw futhark::Error(ctx);
@@ -285,7 +362,7 @@ namespace frontend {
         input_array.clear();
 
         auto resolution = futhark::UniqueArray<int32_t, 1>(ctx);
-        p.measure("resolve vars", [&]{
+        measure_pass(p, "resolve vars", [&]{
             bool valid;
             int err = futhark_entry_frontend_resolve_vars(ctx, &valid, &resolution, node_types, parents, prev_siblings, node_data);
             if (err)
@@ -294,7 +371,7 @@ namespace frontend {
                 throw CompileError(Error::INVALID_VARIABLE);
         });
 
-        p.measure("resolve fns", [&]{
+        measure_pass(p, "resolve fns", [&]{
             auto old_resolution = std::move(resolution);
             bool valid;
             int err = futhark_entry_frontend_resolve_fns(ctx, &valid, &resolution, node_types, old_resolution, node_data);
@@ -304,7 +381,7 @@ namespace frontend {
                 throw CompileError(Error::DUPLICATE_FN_OR_INVALID_CALL);
         });
 
-        p.measure("resolve args", [&]{
+        measure_pass(p, "resolve args", [&]{
             auto old_resolution = std::move(resolution);
             bool valid;
             int err = futhark_entry_frontend_resolve_args(ctx, &valid, &resolution, node_types, parents, prev_siblings, old_resolution);
@@ -315,7 +392,7 @@ namespace frontend {
         });
 
         auto data_types = futhark::UniqueArray<uint8_t, 1>(ctx);
-        p.measure("resolve dtypes", [&]{
+        measure_pass(p, "resolve dtypes", [&]{
             bool valid;
             int err = futhark_entry_frontend_resolve_data_types(ctx, &valid, &data_types, node_types, parents, prev_siblings, resolution.get());
             if (err)
@@ -324,7 +401,7 @@ namespace frontend {
                 throw CompileError(Error::TYPE_ERROR);
         });
 
-        p.measure("check return dtypes", [&]{
+        measure_pass(p, "check return dtypes", [&]{
             bool valid;
             int err = futhark_entry_frontend_check_return_types(ctx, &valid, node_types, parents, data_types);
             if (err)
@@ -333,7 +410,7 @@ namespace frontend {
                 throw CompileError(Error::INVALID_RETURN);
         });
 
-        p.measure("check convergence", [&]{
+        measure_pass(p, "check convergence", [&]{
             bool valid;
             int err = futhark_entry_frontend_check_convergence(ctx, &valid, node_types, parents, prev_siblings);
             if (err)
@@ -343,7 +420,7 @@ namespace frontend {
         });
 
         auto ast = DeviceAst(ctx);
-        p.measure("build ast", [&]{
+        measure_pass(p, "build ast", [&]{
             // Other arrays are destructed at the end of the function.
             int err = futhark_entry_frontend_build_ast(
                 ctx,
@@ -5,35 +5,67 @@
 #include "pareas/compiler/ast.hpp"
 #include "pareas/compiler/frontend.hpp"
 #include "pareas/compiler/backend.hpp"
+#include "pareas/compiler/elf.hpp"
 #include "pareas/profiler/profiler.hpp"
+#include "pareas/common/input_file.hpp"
+#include "pareas/common/host_lexer.hpp"
 
 #include <fmt/format.h>
 #include <fmt/ostream.h>
 #include <fmt/chrono.h>
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <unordered_set>
+#include <vector>
+#include <string>
 #include <string_view>
 #include <memory>
 #include <chrono>
 #include <charconv>
+#include <system_error>
 #include <cstdio>
 #include <cstdlib>
 #include <cstdint>
 #include <cstring>
+#include <cerrno>
 #include <cassert>
 
+#include <fcntl.h>
+#include <unistd.h>
+
+enum class OutputFormat {
+    RAW,
+    ELF_OBJECT,
+    ELF_EXECUTABLE,
+};
+
 struct Options {
-    const char* input_path;
+    std::vector<const char*> input_paths;
     const char* output_path;
+    OutputFormat output_format;
+    bool elf64;
+    uint32_t entry_function;
     bool help;
+    bool server;
     bool dump_dot;
     unsigned profile;
+    pareas::Profiler::Format profile_format;
+    pareas::Profiler::SyncMode profile_sync;
+    unsigned bench;
+    unsigned warmup;
+    bool fused;
     bool verbose_tree;
     bool verbose_mod;
     bool futhark_verbose;
     bool futhark_debug;
     bool futhark_debug_extra;
+    bool futhark_clear_caches;
+
+    pareas::LexerOptions lexer;
 
     // Options available for the multicore backend
     int threads;
@@ -45,12 +77,44 @@ struct Options {
 
 void print_usage(char* progname) {
     fmt::print(
-        "Usage: {} [options...] <input path>\n"
+        "Usage: {0} [options...] <input path>\n"
+        "       {0} [options...] <input paths...> -o <output directory>\n"
+        "       {0} [options...] --server\n"
         "Available options:\n"
         "-o --output <output path>   Write the output to <output path>. (default: b.out)\n"
+        "                            When multiple inputs are given, this is a\n"
+        "                            directory, and the output of every input is\n"
+        "                            written to <output path>/<input name>.out.\n"
+        "-f --format <format>        Set the output format. Available formats are 'raw'\n"
+        "                            (instructions only), 'obj' (ELF relocatable object)\n"
+        "                            and 'exe' (static ELF executable). (default: raw)\n"
+        "--elf64                     Write ELF64 instead of ELF32 files.\n"
+        "--entry <function id>       Function called by the startup code of executables.\n"
+        "                            Functions are numbered in order of declaration.\n"
+        "                            (default: 0)\n"
         "-h --help                   Show this message and exit.\n"
+        "--server                    Keep the Futhark context and grammar tables\n"
+        "                            resident, and read compile jobs from standard\n"
+        "                            input. See below.\n"
         "--dump-dot                  Dump tree as dot graph.\n"
         "-p --profile <level>        Record (non-futhark) profiling information.\n"
+        "--profile-format <format>   Format of the profiling information: 'text', 'csv'\n"
+        "                            or 'chrome' (Chrome trace event JSON).\n"
+        "                            (default: text)\n"
+        "--profile-sync <mode>       When profiled regions wait for the device: 'eager'\n"
+        "                            (around every region) or 'lazy' (around the\n"
+        "                            outermost regions only, so nested regions only\n"
+        "                            measure the time to enqueue their work, and are\n"
+        "                            marked as such in the profile). Use\n"
+        "                            --futhark-profile for the device time per kernel.\n"
+        "                            (default: eager)\n"
+        "--bench <runs>              Process the input <runs> times using the same\n"
+        "                            context, and report statistics per profiled\n"
+        "                            region instead of a single profile.\n"
+        "--warmup <runs>             Number of unmeasured runs before benchmarking.\n"
+        "                            (default: 1)\n"
+        "--fused                     Run the syntax passes as a single Futhark entry\n"
+        "                            point, rather than one entry point per pass.\n"
         "--verbose-tree              Dump some information about the tree to stderr.\n"
         "                            (default: 0, =disabled)\n"
         "--verbose-mod               Dump some information about the final module to\n"
@@ -59,6 +123,18 @@ void print_usage(char* progname) {
         "--futhark-debug             Enable Futhark debug logging.\n"
         "--futhark-debug-extra       Futhark debug logging with extra information.\n"
         "                            Not compatible with --futhark-debug.\n"
+        "--futhark-clear-caches      Release the memory that Futhark keeps for reuse\n"
+        "                            after every input, so that every compile starts\n"
+        "                            without cached device memory.\n"
+        "--lexer <backend>           Where the input is lexed: 'device', 'host' (the\n"
+        "                            native lexer, using the merge table), 'dfa' (the\n"
+        "                            native lexer, speculatively using the DFA) or\n"
+        "                            'auto' ('dfa' for inputs smaller than the host\n"
+        "                            lexer threshold, 'device' otherwise).\n"
+        "                            (default: auto)\n"
+        "--host-lexer-threshold <bytes>\n"
+        "                            Input size below which 'auto' uses the host\n"
+        "                            lexer. (default: {1})\n"
     #if defined(FUTHARK_BACKEND_multicore)
         "Available backend options:\n"
         "-t --threads <amount>       Set the maximum number of threads that may be used\n"
@@ -73,30 +149,66 @@ void print_usage(char* progname) {
     #endif
         "\n"
         "When <input path> and/or <output path> are '-', standard input and standard\n"
-        "output are used respectively.\n",
-        progname
+        "output are used respectively.\n"
+        "\n"
+        "When multiple inputs are given, they are compiled one after another using the\n"
+        "same Futhark context, which saves starting pareas once per input. Every input\n"
+        "is still compiled using its own kernel launches. An error in one input does\n"
+        "not stop the compilation of the others. The profile of every input is reported\n"
+        "as a region named after the input path.\n"
+        "\n"
+        "In server mode, every line on standard input describes a job of the form\n"
+        "'<input path><TAB><output path>'. For every job, a reply header of the form\n"
+        "'ok <size>' or 'error <size>' is written to standard output, followed by <size>\n"
+        "bytes of payload: the profile of the job (see --profile), or an error message.\n"
+        "Job paths cannot be '-'. The server exits when standard input is closed.\n",
+        progname,
+        pareas::DEFAULT_HOST_LEXER_THRESHOLD
     );
 }
 
 bool parse_options(Options* opts, int argc, char* argv[]) {
     *opts = {
-        .input_path = nullptr,
-        .output_path = "b.out",
+        .input_paths = {},
+        .output_path = nullptr,
+        .output_format = OutputFormat::RAW,
+        .elf64 = false,
+        .entry_function = 0,
         .help = false,
+        .server = false,
         .dump_dot = false,
         .profile = 0,
+        .profile_format = pareas::Profiler::Format::TEXT,
+        .profile_sync = pareas::Profiler::SyncMode::EAGER,
+        .bench = 0,
+        .warmup = 1,
+        .fused = false,
         .verbose_tree = false,
         .verbose_mod = false,
         .futhark_verbose = false,
         .futhark_debug = false,
         .futhark_debug_extra = false,
+        .futhark_clear_caches = false,
+        .lexer = {
+            .backend = pareas::LexerBackend::AUTO,
+            .host_threshold = pareas::DEFAULT_HOST_LEXER_THRESHOLD,
+            .host_threads = 0,
+        },
         .threads = 0,
         .device_name = nullptr,
         .futhark_profile = false,
     };
 
     const char* threads_arg = nullptr;
+    const char* lexer_arg = nullptr;
+    const char* host_lexer_threshold_arg = nullptr;
     const char* profile_arg = nullptr;
+    const char* format_arg = nullptr;
+    const char* profile_format_arg = nullptr;
+    const char* profile_sync_arg = nullptr;
+    const char* bench_arg = nullptr;
+    const char* warmup_arg = nullptr;
+    const char* entry_arg = nullptr;
 
     for (int i = 1; i < argc; ++i) {
         auto arg = std::string_view(argv[i]);
@@ -132,8 +244,24 @@ bool parse_options(Options* opts, int argc, char* argv[]) {
                 return false;
             }
             opts->output_path = argv[i];
+        } else if (arg == "-f" || arg == "--format") {
+            if (++i >= argc) {
+                fmt::print(std::cerr, "Error: Expected argument <format> to option {}\n", arg);
+                return false;
+            }
+            format_arg = argv[i];
+        } else if (arg == "--elf64") {
+            opts->elf64 = true;
+        } else if (arg == "--entry") {
+            if (++i >= argc) {
+                fmt::print(std::cerr, "Error: Expected argument <function id> to option {}\n", arg);
+                return false;
+            }
+            entry_arg = argv[i];
         } else if (arg == "-h" || arg == "--help") {
             opts->help = true;
+        } else if (arg == "--server") {
+            opts->server = true;
         } else if (arg == "--dump-dot") {
             opts->dump_dot = true;
         } else if (arg == "-p" || arg == "--profile") {
@@ -143,6 +271,50 @@ bool parse_options(Options* opts, int argc, char* argv[]) {
             }
 
             profile_arg = argv[i];
+        } else if (arg == "--profile-format") {
+            if (++i >= argc) {
+                fmt::print(std::cerr, "Error: Expected argument <format> to option {}\n", arg);
+                return false;
+            }
+
+            profile_format_arg = argv[i];
+        } else if (arg == "--profile-sync") {
+            if (++i >= argc) {
+                fmt::print(std::cerr, "Error: Expected argument <mode> to option {}\n", arg);
+                return false;
+            }
+
+            profile_sync_arg = argv[i];
+        } else if (arg == "--bench") {
+            if (++i >= argc) {
+                fmt::print(std::cerr, "Error: Expected argument <runs> to option {}\n", arg);
+                return false;
+            }
+
+            bench_arg = argv[i];
+        } else if (arg == "--warmup") {
+            if (++i >= argc) {
+                fmt::print(std::cerr, "Error: Expected argument <runs> to option {}\n", arg);
+                return false;
+            }
+
+            warmup_arg = argv[i];
+        } else if (arg == "--lexer") {
+            if (++i >= argc) {
+                fmt::print(std::cerr, "Error: Expected argument <backend> to option {}\n", arg);
+                return false;
+            }
+
+            lexer_arg = argv[i];
+        } else if (arg == "--host-lexer-threshold") {
+            if (++i >= argc) {
+                fmt::print(std::cerr, "Error: Expected argument <bytes> to option {}\n", arg);
+                return false;
+            }
+
+            host_lexer_threshold_arg = argv[i];
+        } else if (arg == "--fused") {
+            opts->fused = true;
         } else if (arg == "--verbose-tree") {
             opts->verbose_tree = true;
         } else if (arg == "--verbose-mod") {
@@ -153,29 +325,49 @@ bool parse_options(Options* opts, int argc, char* argv[]) {
             opts->futhark_debug = true;
         } else if (arg == "--futhark-debug-extra") {
             opts->futhark_debug_extra = true;
-        } else if (!opts->input_path) {
-            opts->input_path = argv[i];
-        } else {
+        } else if (arg == "--futhark-clear-caches") {
+            opts->futhark_clear_caches = true;
+        } else if (arg.size() > 1 && arg[0] == '-') {
             fmt::print(std::cerr, "Error: Unknown option {}\n", arg);
             return false;
+        } else {
+            opts->input_paths.push_back(argv[i]);
         }
     }
 
     if (opts->help)
         return true;
 
-    if (!opts->input_path) {
+    if (opts->server && !opts->input_paths.empty()) {
+        fmt::print(std::cerr, "Error: <input path> may not be given in server mode\n");
+        return false;
+    } else if (opts->server && opts->dump_dot) {
+        fmt::print(std::cerr, "Error: --dump-dot is incompatible with --server\n");
+        return false;
+    } else if (!opts->server && opts->input_paths.empty()) {
         fmt::print(std::cerr, "Error: Missing required argument <input path>\n");
         return false;
-    } else if (!opts->input_path[0]) {
-        fmt::print(std::cerr, "Error: <input path> may not be empty\n");
+    } else if (opts->input_paths.size() > 1 && !opts->output_path) {
+        fmt::print(std::cerr, "Error: Multiple inputs require an explicit <output directory>\n");
+        return false;
+    } else if (opts->input_paths.size() > 1 && opts->dump_dot) {
+        fmt::print(std::cerr, "Error: --dump-dot is incompatible with multiple inputs\n");
         return false;
     } else if (opts->futhark_debug && opts->futhark_debug_extra) {
         fmt::print(std::cerr, "Error: --futhark-debug is incompatible with --futhark-debug-extra\n");
         return false;
     }
 
-    if (!opts->output_path[0]) {
+    for (const auto* input_path : opts->input_paths) {
+        if (!input_path[0]) {
+            fmt::print(std::cerr, "Error: <input path> may not be empty\n");
+            return false;
+        }
+    }
+
+    if (!opts->output_path) {
+        opts->output_path = "b.out";
+    } else if (!opts->output_path[0]) {
         fmt::print(std::cerr, "Error: <output path> may not be empty\n");
         return false;
     }
@@ -189,6 +381,86 @@ bool parse_options(Options* opts, int argc, char* argv[]) {
         }
     }
 
+    // The host lexer is limited to the same number of threads as the Futhark context.
+    opts->lexer.host_threads = opts->threads;
+
+    if (lexer_arg) {
+        auto backend = pareas::parse_lexer_backend(lexer_arg);
+        if (!backend) {
+            fmt::print(std::cerr, "Error: Invalid value '{}' for option --lexer\n", lexer_arg);
+            return false;
+        }
+        opts->lexer.backend = *backend;
+    }
+
+    if (host_lexer_threshold_arg) {
+        const auto* end = host_lexer_threshold_arg + std::strlen(host_lexer_threshold_arg);
+        auto [p, ec] = std::from_chars(host_lexer_threshold_arg, end, opts->lexer.host_threshold);
+        if (ec != std::errc() || p != end) {
+            fmt::print(std::cerr, "Error: Invalid value '{}' for option --host-lexer-threshold\n", host_lexer_threshold_arg);
+            return false;
+        }
+    }
+
+    if (bench_arg) {
+        const auto* end = bench_arg + std::strlen(bench_arg);
+        auto [p, ec] = std::from_chars(bench_arg, end, opts->bench);
+        if (ec != std::errc() || p != end || opts->bench < 1) {
+            fmt::print(std::cerr, "Error: Invalid value '{}' for option --bench\n", bench_arg);
+            return false;
+        }
+    }
+
+    if (warmup_arg) {
+        const auto* end = warmup_arg + std::strlen(warmup_arg);
+        auto [p, ec] = std::from_chars(warmup_arg, end, opts->warmup);
+        if (ec != std::errc() || p != end) {
+            fmt::print(std::cerr, "Error: Invalid value '{}' for option --warmup\n", warmup_arg);
+            return false;
+        }
+    }
+
+    if (profile_format_arg) {
+        auto format = pareas::Profiler::parse_format(profile_format_arg);
+        if (!format) {
+            fmt::print(std::cerr, "Error: Invalid value '{}' for option --profile-format\n", profile_format_arg);
+            return false;
+        }
+        opts->profile_format = *format;
+    }
+
+    if (profile_sync_arg) {
+        auto sync_mode = pareas::Profiler::parse_sync_mode(profile_sync_arg);
+        if (!sync_mode) {
+            fmt::print(std::cerr, "Error: Invalid value '{}' for option --profile-sync\n", profile_sync_arg);
+            return false;
+        }
+        opts->profile_sync = *sync_mode;
+    }
+
+    if (format_arg) {
+        auto format = std::string_view(format_arg);
+        if (format == "raw") {
+            opts->output_format = OutputFormat::RAW;
+        } else if (format == "obj") {
+            opts->output_format = OutputFormat::ELF_OBJECT;
+        } else if (format == "exe") {
+            opts->output_format = OutputFormat::ELF_EXECUTABLE;
+        } else {
+            fmt::print(std::cerr, "Error: Invalid value '{}' for option --format\n", format_arg);
+            return false;
+        }
+    }
+
+    if (entry_arg) {
+        const auto* end = entry_arg + std::strlen(entry_arg);
+        auto [p, ec] = std::from_chars(entry_arg, end, opts->entry_function);
+        if (ec != std::errc() || p != end) {
+            fmt::print(std::cerr, "Error: Invalid value '{}' for option --entry\n", entry_arg);
+            return false;
+        }
+    }
+
     if (profile_arg) {
         const auto* end = profile_arg + std::strlen(profile_arg);
         auto [p, ec] = std::from_chars(profile_arg, end, opts->profile);
@@ -198,6 +470,19 @@ bool parse_options(Options* opts, int argc, char* argv[]) {
         }
     }
 
+    if (opts->bench > 0) {
+        if (opts->server || opts->input_paths.size() > 1) {
+            fmt::print(std::cerr, "Error: --bench requires a single <input path>\n");
+            return false;
+        } else if (opts->dump_dot) {
+            fmt::print(std::cerr, "Error: --dump-dot is incompatible with --bench\n");
+            return false;
+        }
+
+        // Benchmarking without any profiled regions is pointless, so at least profile the top level.
+        opts->profile = std::max(opts->profile, 1u);
+    }
+
     return true;
 }
 
@@ -211,6 +496,212 @@ struct Free {
 template <typename T>
 using MallocPtr = std::unique_ptr<T, Free<T>>;
 
+pareas::Profiler make_profiler(futhark_context* ctx, const Options& opts) {
+    auto p = pareas::Profiler(opts.profile);
+    p.set_sync_mode(opts.profile_sync);
+    p.set_sync_callback([ctx]{
+        if (futhark_context_sync(ctx))
+            throw futhark::Error(ctx);
+    });
+    return p;
+}
+
+void clear_caches(futhark_context* ctx, const Options& opts) {
+    if (opts.futhark_clear_caches && futhark_context_clear_caches(ctx))
+        throw futhark::Error(ctx);
+}
+
+void write_output(const HostModule& mod, const Options& opts, const char* output_path) {
+    if (opts.output_format == OutputFormat::RAW) {
+        auto out = std::ofstream(output_path, std::ios::binary);
+        if (!out)
+            throw std::runtime_error(fmt::format("Failed to open output file '{}'", output_path));
+
+        out.write(reinterpret_cast<const char*>(mod.instructions.get()), mod.num_instructions * sizeof(uint32_t));
+        return;
+    }
+
+    auto elf_opts = elf::Options{
+        .type = opts.output_format == OutputFormat::ELF_EXECUTABLE ? elf::FileType::EXECUTABLE : elf::FileType::RELOCATABLE,
+        .elf_class = opts.elf64 ? elf::Class::ELF64 : elf::Class::ELF32,
+        .entry_function = opts.entry_function,
+    };
+
+    if (std::strcmp(output_path, "-") == 0) {
+        elf::write(STDOUT_FILENO, mod, elf_opts);
+        return;
+    }
+
+    mode_t mode = elf_opts.type == elf::FileType::EXECUTABLE ? 0777 : 0666;
+    int fd = open(output_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), fmt::format("Failed to open output file '{}'", output_path));
+
+    try {
+        elf::write(fd, mod, elf_opts);
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+
+    close(fd);
+}
+
+void compile_file(
+    futhark_context* ctx,
+    const frontend::GrammarTables& tables,
+    const Options& opts,
+    const char* input_path,
+    const char* output_path,
+    pareas::Profiler& p
+) {
+    p.begin();
+    auto input = pareas::InputFile(input_path);
+    p.end("read input");
+
+    p.begin();
+    auto ast = frontend::compile(ctx, tables, input.contents(), opts.lexer, opts.fused, opts.verbose_tree, p, opts.futhark_debug_extra ? stderr : nullptr);
+    p.end("frontend");
+
+    p.begin();
+    auto module = backend::compile(ctx, ast, p);
+    p.end("backend");
+
+    if (opts.dump_dot) {
+        p.begin();
+        auto host_ast = ast.download();
+        p.end("ast download");
+        host_ast.dump_dot(std::cout);
+    }
+
+    auto host_mod = module.download();
+
+    if (opts.verbose_mod) {
+        host_mod.dump(std::cerr);
+    }
+
+    p.begin();
+    write_output(host_mod, opts, output_path);
+    p.end("write output");
+}
+
+void reply(std::string_view status, std::string_view payload) {
+    fmt::print(std::cout, "{} {}\n{}", status, payload.size(), payload);
+    std::cout.flush();
+}
+
+void serve(futhark_context* ctx, const frontend::GrammarTables& tables, const Options& opts) {
+    auto line = std::string();
+    while (std::getline(std::cin, line)) {
+        if (line.empty())
+            continue;
+
+        auto sep = line.find('\t');
+        if (sep == std::string::npos) {
+            reply("error", "Malformed job, expected '<input path><TAB><output path>'\n");
+            continue;
+        }
+
+        auto input_path = line.substr(0, sep);
+        auto output_path = line.substr(sep + 1);
+
+        // Standard input and output carry the protocol itself.
+        if (input_path == "-" || output_path == "-") {
+            reply("error", "Standard input and output cannot be used by jobs in server mode\n");
+            continue;
+        }
+
+        // Use a fresh profiler for every job, so that the history of a failed job is discarded.
+        auto p = make_profiler(ctx, opts);
+
+        try {
+            compile_file(ctx, tables, opts, input_path.c_str(), output_path.c_str(), p);
+            clear_caches(ctx, opts);
+        } catch (const frontend::CompileError& err) {
+            reply("error", fmt::format("Compile error: {}\n", err.what()));
+            continue;
+        } catch (const futhark::Error& err) {
+            reply("error", fmt::format("Futhark error: {}\n", err.what()));
+            continue;
+        } catch (const std::runtime_error& err) {
+            reply("error", fmt::format("Error: {}\n", err.what()));
+            continue;
+        }
+
+        auto profile = std::ostringstream();
+        if (opts.profile > 0)
+            p.dump(profile, opts.profile_format);
+        reply("ok", profile.str());
+    }
+}
+
+void bench(futhark_context* ctx, const frontend::GrammarTables& tables, const Options& opts) {
+    auto stats = pareas::ProfileStatistics();
+
+    for (unsigned i = 0; i < opts.warmup + opts.bench; ++i) {
+        auto p = make_profiler(ctx, opts);
+        compile_file(ctx, tables, opts, opts.input_paths[0], opts.output_path, p);
+        clear_caches(ctx, opts);
+
+        if (i >= opts.warmup)
+            stats.add(p);
+    }
+
+    stats.dump(std::cout, opts.profile_format);
+}
+
+bool compile_batch(futhark_context* ctx, const frontend::GrammarTables& tables, const Options& opts, pareas::Profiler& p) {
+    auto output_dir = std::filesystem::path(opts.output_path);
+    auto output_paths = std::vector<std::filesystem::path>();
+    auto seen = std::unordered_set<std::string>();
+
+    for (const auto* input_path : opts.input_paths) {
+        auto name = std::filesystem::path(input_path).filename().replace_extension(".out");
+        if (!seen.insert(name.string()).second) {
+            fmt::print(std::cerr, "Error: Multiple inputs map to output file '{}'\n", name.string());
+            return false;
+        }
+
+        output_paths.push_back(output_dir / name);
+    }
+
+    auto ec = std::error_code();
+    std::filesystem::create_directories(output_dir, ec);
+    if (ec) {
+        fmt::print(std::cerr, "Error: Failed to create output directory '{}': {}\n", opts.output_path, ec.message());
+        return false;
+    }
+
+    // The profile of every input that compiled successfully is appended to `p`, so that the startup and all
+    // inputs are reported in a single document.
+    bool success = true;
+    for (size_t i = 0; i < opts.input_paths.size(); ++i) {
+        const auto* input_path = opts.input_paths[i];
+        auto input_p = make_profiler(ctx, opts);
+
+        try {
+            compile_file(ctx, tables, opts, input_path, output_paths[i].c_str(), input_p);
+            clear_caches(ctx, opts);
+        } catch (const frontend::CompileError& err) {
+            fmt::print(std::cerr, "{}: Compile error: {}\n", input_path, err.what());
+            success = false;
+            continue;
+        } catch (const futhark::Error& err) {
+            fmt::print(std::cerr, "{}: Futhark error: {}\n", input_path, err.what());
+            success = false;
+            continue;
+        } catch (const std::runtime_error& err) {
+            fmt::print(std::cerr, "{}: Error: {}\n", input_path, err.what());
+            success = false;
+            continue;
+        }
+
+        p.append(input_p, input_path);
+    }
+
+    return success;
+}
+
 int main(int argc, char* argv[]) {
     Options opts;
     if (!parse_options(&opts, argc, argv)) {
@@ -222,15 +713,7 @@ int main(int argc, char* argv[]) {
     }
 
     auto p = pareas::Profiler(opts.profile);
-
-    auto in = std::ifstream(opts.input_path, std::ios::binary);
-    if (!in) {
-        fmt::print(std::cerr, "Error: Failed to open input file '{}'\n", opts.input_path);
-        return EXIT_FAILURE;
-    }
-
-    auto input = std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
-    in.close();
+    p.set_sync_mode(opts.profile_sync);
 
     p.begin();
     auto config = futhark::ContextConfig(futhark_context_config_new());
@@ -257,47 +740,46 @@ int main(int argc, char* argv[]) {
 
     try {
         p.begin();
-        auto ast = frontend::compile(ctx.get(), input, opts.verbose_tree, p, opts.futhark_debug_extra ? stderr : nullptr);
-        p.end("frontend");
-
-        p.begin();
-        auto module = backend::compile(ctx.get(), ast, p);
-        p.end("backend");
-
-        if (opts.profile > 0)
-            p.dump(std::cout);
-
-        if (opts.dump_dot) {
-            p.begin();
-            auto host_ast = ast.download();
-            p.end("ast download");
-            host_ast.dump_dot(std::cout);
-        }
-
-        auto host_mod = module.download();
+        auto tables = frontend::upload_tables(ctx.get());
+        p.end("table upload");
+
+        bool success = true;
+        if (opts.server) {
+            // Stdout is used for replies, so report the startup profile on stderr instead.
+            if (opts.profile > 0)
+                p.dump(std::cerr, opts.profile_format);
+
+            serve(ctx.get(), tables, opts);
+        } else if (opts.bench > 0) {
+            bench(ctx.get(), tables, opts);
+        } else if (opts.input_paths.size() > 1) {
+            success = compile_batch(ctx.get(), tables, opts, p);
+
+            if (opts.profile > 0)
+                p.dump(std::cout, opts.profile_format);
+        } else {
+            compile_file(ctx.get(), tables, opts, opts.input_paths[0], opts.output_path, p);
 
-        if (opts.verbose_mod) {
-            host_mod.dump(std::cerr);
+            if (opts.profile > 0)
+                p.dump(std::cout, opts.profile_format);
         }
 
-        auto out = std::ofstream(opts.output_path, std::ios::binary);
-        if (!out) {
-            fmt::print(std::cerr, "Failed to open output file '{}'\n", opts.output_path);
-            return EXIT_FAILURE;
-        }
-
-        out.write(reinterpret_cast<const char*>(host_mod.instructions.get()), host_mod.num_instructions * sizeof(uint32_t));
-
         if (opts.futhark_profile) {
             auto report = MallocPtr<char>(futhark_context_report(ctx.get()));
             fmt::print(std::cerr, "Futhark profile report:\n{}", report);
         }
+
+        if (!success)
+            return EXIT_FAILURE;
     } catch (const frontend::CompileError& err) {
         fmt::print(std::cerr, "Compile error: {}\n", err.what());
         return EXIT_FAILURE;
     } catch (const futhark::Error& err) {
         fmt::print(std::cerr, "Futhark error: {}\n", err.what());
         return EXIT_FAILURE;
+    } catch (const std::runtime_error& err) {
+        fmt::print(std::cerr, "Error: {}\n", err.what());
+        return EXIT_FAILURE;
     }
 
     return EXIT_SUCCESS;
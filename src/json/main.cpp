@@ -3,18 +3,25 @@
 
 #include "pareas/json/futhark_interop.hpp"
 #include "pareas/profiler/profiler.hpp"
+#include "pareas/common/input_file.hpp"
+#include "pareas/common/host_lexer.hpp"
 
 #include <fmt/format.h>
 #include <fmt/ostream.h>
 #include <fmt/chrono.h>
 
+#include <algorithm>
 #include <memory>
+#include <optional>
+#include <vector>
+#include <system_error>
+#include <string_view>
 #include <stdexcept>
 #include <iostream>
-#include <fstream>
 #include <charconv>
 #include <cstdlib>
 #include <cstdio>
+#include <cassert>
 
 // This file is mostly just copied from src/compiler/main.cpp
 
@@ -26,6 +33,15 @@ struct Options {
     bool futhark_debug_extra;
     bool dump_dot;
     bool verbose_tree;
+    pareas::Profiler::Format profile_format;
+    pareas::Profiler::SyncMode profile_sync;
+    unsigned bench;
+    unsigned warmup;
+    bool throughput;
+    size_t upload_block_size;
+    size_t stream_window_size;
+
+    pareas::LexerOptions lexer;
 
     // Options available for the multicore backend
     int threads;
@@ -37,7 +53,7 @@ struct Options {
 
 void print_usage(char* progname) {
     fmt::print(
-        "Usage: {} [options...] <input path>\n"
+        "Usage: {0} [options...] <input path>\n"
         "Available options:\n"
         "-h --help                   Show this message and exit.\n"
         "--futhark-verbose           Enable Futhark logging.\n"
@@ -46,6 +62,41 @@ void print_usage(char* progname) {
         "                            Not compatible with --futhark-debug.\n"
         "--dump-dot                  Dump JSON tree as dot graph. Disables profiling.\n"
         "--verbose-tree              Print some information about the document tree.\n"
+        "--profile-format <format>   Format of the profiling information: 'text', 'csv'\n"
+        "                            or 'chrome' (Chrome trace event JSON).\n"
+        "                            (default: text)\n"
+        "--profile-sync <mode>       When profiled regions wait for the device: 'eager'\n"
+        "                            (around every region) or 'lazy' (around the\n"
+        "                            outermost regions only, so nested regions only\n"
+        "                            measure the time to enqueue their work, and are\n"
+        "                            marked as such in the profile). Use\n"
+        "                            --futhark-profile for the device time per kernel.\n"
+        "                            (default: eager)\n"
+        "--bench <runs>              Process the input <runs> times using the same\n"
+        "                            context, and report statistics per profiled\n"
+        "                            region instead of a single profile.\n"
+        "--warmup <runs>             Number of unmeasured runs before benchmarking.\n"
+        "                            (default: 1)\n"
+        "--throughput                Also report the throughput of every profiled\n"
+        "                            region in GB/s of input. Requires --bench.\n"
+        "--chunked-upload <bytes>    Upload the input in blocks of <bytes> bytes, and\n"
+        "                            summarize every block as soon as it is uploaded.\n"
+        "                            This only overlaps upload and lexing on the GPU\n"
+        "                            backends. Only applies when lexing on the device.\n"
+        "--stream <bytes>            Only validate the document, reading, lexing and\n"
+        "                            checking it in windows of <bytes> bytes, so that\n"
+        "                            it never needs to be in memory as a whole. The\n"
+        "                            throughput of every window is reported on stderr.\n"
+        "                            Always lexes on the device.\n"
+        "--lexer <backend>           Where the input is lexed: 'device', 'host' (the\n"
+        "                            native lexer, using the merge table), 'dfa' (the\n"
+        "                            native lexer, speculatively using the DFA) or\n"
+        "                            'auto' ('dfa' for inputs smaller than the host\n"
+        "                            lexer threshold, 'device' otherwise).\n"
+        "                            (default: auto)\n"
+        "--host-lexer-threshold <bytes>\n"
+        "                            Input size below which 'auto' uses the host\n"
+        "                            lexer. (default: {1})\n"
     #if defined(FUTHARK_BACKEND_multicore)
         "Available backend options:\n"
         "-t --threads <amount>       Set the maximum number of threads that may be used\n"
@@ -60,7 +111,8 @@ void print_usage(char* progname) {
     #endif
         "\n"
         "When <input path> is '-', standard input is used\n",
-        progname
+        progname,
+        pareas::DEFAULT_HOST_LEXER_THRESHOLD
     );
 }
 
@@ -73,12 +125,32 @@ bool parse_options(Options* opts, int argc, char* argv[]) {
         .futhark_debug_extra = false,
         .dump_dot = false,
         .verbose_tree = false,
+        .profile_format = pareas::Profiler::Format::TEXT,
+        .profile_sync = pareas::Profiler::SyncMode::EAGER,
+        .bench = 0,
+        .warmup = 1,
+        .throughput = false,
+        .upload_block_size = 0,
+        .stream_window_size = 0,
+        .lexer = {
+            .backend = pareas::LexerBackend::AUTO,
+            .host_threshold = pareas::DEFAULT_HOST_LEXER_THRESHOLD,
+            .host_threads = 0,
+        },
         .threads = 0,
         .device_name = nullptr,
         .futhark_profile = false,
     };
 
     const char* threads_arg = nullptr;
+    const char* lexer_arg = nullptr;
+    const char* host_lexer_threshold_arg = nullptr;
+    const char* profile_format_arg = nullptr;
+    const char* profile_sync_arg = nullptr;
+    const char* bench_arg = nullptr;
+    const char* warmup_arg = nullptr;
+    const char* chunked_upload_arg = nullptr;
+    const char* stream_arg = nullptr;
 
     for (int i = 1; i < argc; ++i) {
         auto arg = std::string_view(argv[i]);
@@ -118,8 +190,66 @@ bool parse_options(Options* opts, int argc, char* argv[]) {
             opts->futhark_debug_extra = true;
         } else if (arg == "--dump-dot") {
             opts->dump_dot = true;
+        } else if (arg == "--lexer") {
+            if (++i >= argc) {
+                fmt::print(std::cerr, "Error: Expected argument <backend> to option {}\n", arg);
+                return false;
+            }
+
+            lexer_arg = argv[i];
+        } else if (arg == "--host-lexer-threshold") {
+            if (++i >= argc) {
+                fmt::print(std::cerr, "Error: Expected argument <bytes> to option {}\n", arg);
+                return false;
+            }
+
+            host_lexer_threshold_arg = argv[i];
         } else if (arg == "--verbose-tree") {
             opts->verbose_tree = true;
+        } else if (arg == "--profile-format") {
+            if (++i >= argc) {
+                fmt::print(std::cerr, "Error: Expected argument <format> to option {}\n", arg);
+                return false;
+            }
+
+            profile_format_arg = argv[i];
+        } else if (arg == "--profile-sync") {
+            if (++i >= argc) {
+                fmt::print(std::cerr, "Error: Expected argument <mode> to option {}\n", arg);
+                return false;
+            }
+
+            profile_sync_arg = argv[i];
+        } else if (arg == "--bench") {
+            if (++i >= argc) {
+                fmt::print(std::cerr, "Error: Expected argument <runs> to option {}\n", arg);
+                return false;
+            }
+
+            bench_arg = argv[i];
+        } else if (arg == "--warmup") {
+            if (++i >= argc) {
+                fmt::print(std::cerr, "Error: Expected argument <runs> to option {}\n", arg);
+                return false;
+            }
+
+            warmup_arg = argv[i];
+        } else if (arg == "--throughput") {
+            opts->throughput = true;
+        } else if (arg == "--chunked-upload") {
+            if (++i >= argc) {
+                fmt::print(std::cerr, "Error: Expected argument <bytes> to option {}\n", arg);
+                return false;
+            }
+
+            chunked_upload_arg = argv[i];
+        } else if (arg == "--stream") {
+            if (++i >= argc) {
+                fmt::print(std::cerr, "Error: Expected argument <bytes> to option {}\n", arg);
+                return false;
+            }
+
+            stream_arg = argv[i];
         } else if (!opts->input_path) {
             opts->input_path = argv[i];
         } else {
@@ -142,6 +272,68 @@ bool parse_options(Options* opts, int argc, char* argv[]) {
         return false;
     }
 
+    if (bench_arg) {
+        const auto* end = bench_arg + std::strlen(bench_arg);
+        auto [p, ec] = std::from_chars(bench_arg, end, opts->bench);
+        if (ec != std::errc() || p != end || opts->bench < 1) {
+            fmt::print(std::cerr, "Error: Invalid value '{}' for option --bench\n", bench_arg);
+            return false;
+        }
+    }
+
+    if (warmup_arg) {
+        const auto* end = warmup_arg + std::strlen(warmup_arg);
+        auto [p, ec] = std::from_chars(warmup_arg, end, opts->warmup);
+        if (ec != std::errc() || p != end) {
+            fmt::print(std::cerr, "Error: Invalid value '{}' for option --warmup\n", warmup_arg);
+            return false;
+        }
+    }
+
+    if (profile_format_arg) {
+        auto format = pareas::Profiler::parse_format(profile_format_arg);
+        if (!format) {
+            fmt::print(std::cerr, "Error: Invalid value '{}' for option --profile-format\n", profile_format_arg);
+            return false;
+        }
+        opts->profile_format = *format;
+    }
+
+    if (chunked_upload_arg) {
+        const auto* end = chunked_upload_arg + std::strlen(chunked_upload_arg);
+        auto [p, ec] = std::from_chars(chunked_upload_arg, end, opts->upload_block_size);
+        if (ec != std::errc() || p != end || opts->upload_block_size < 1) {
+            fmt::print(std::cerr, "Error: Invalid value '{}' for option --chunked-upload\n", chunked_upload_arg);
+            return false;
+        }
+    }
+
+    if (stream_arg) {
+        const auto* end = stream_arg + std::strlen(stream_arg);
+        auto [p, ec] = std::from_chars(stream_arg, end, opts->stream_window_size);
+        if (ec != std::errc() || p != end || opts->stream_window_size < 1) {
+            fmt::print(std::cerr, "Error: Invalid value '{}' for option --stream\n", stream_arg);
+            return false;
+        }
+
+        if (opts->bench > 0) {
+            fmt::print(std::cerr, "Error: --stream is incompatible with --bench\n");
+            return false;
+        } else if (opts->dump_dot) {
+            fmt::print(std::cerr, "Error: --stream is incompatible with --dump-dot\n");
+            return false;
+        }
+    }
+
+    if (profile_sync_arg) {
+        auto sync_mode = pareas::Profiler::parse_sync_mode(profile_sync_arg);
+        if (!sync_mode) {
+            fmt::print(std::cerr, "Error: Invalid value '{}' for option --profile-sync\n", profile_sync_arg);
+            return false;
+        }
+        opts->profile_sync = *sync_mode;
+    }
+
     if (threads_arg) {
         const auto* end = threads_arg + std::strlen(threads_arg);
         auto [p, ec] = std::from_chars(threads_arg, end, opts->threads);
@@ -151,6 +343,35 @@ bool parse_options(Options* opts, int argc, char* argv[]) {
         }
     }
 
+    // The host lexer is limited to the same number of threads as the Futhark context.
+    opts->lexer.host_threads = opts->threads;
+
+    if (lexer_arg) {
+        auto backend = pareas::parse_lexer_backend(lexer_arg);
+        if (!backend) {
+            fmt::print(std::cerr, "Error: Invalid value '{}' for option --lexer\n", lexer_arg);
+            return false;
+        }
+        opts->lexer.backend = *backend;
+    }
+
+    if (host_lexer_threshold_arg) {
+        const auto* end = host_lexer_threshold_arg + std::strlen(host_lexer_threshold_arg);
+        auto [p, ec] = std::from_chars(host_lexer_threshold_arg, end, opts->lexer.host_threshold);
+        if (ec != std::errc() || p != end) {
+            fmt::print(std::cerr, "Error: Invalid value '{}' for option --host-lexer-threshold\n", host_lexer_threshold_arg);
+            return false;
+        }
+    }
+
+    if (opts->bench > 0 && opts->dump_dot) {
+        fmt::print(std::cerr, "Error: --dump-dot is incompatible with --bench\n");
+        return false;
+    } else if (opts->throughput && opts->bench == 0) {
+        fmt::print(std::cerr, "Error: --throughput requires --bench\n");
+        return false;
+    }
+
     return true;
 }
 
@@ -164,14 +385,38 @@ struct Free {
 template <typename T>
 using MallocPtr = std::unique_ptr<T, Free<T>>;
 
+pareas::HostLexer::BasicTables<json::LexTable::State> host_lex_tables() {
+    static_assert(sizeof(json::Token) == sizeof(pareas::HostLexer::TokenType));
+
+    return {
+        .n = json::lex_table.n,
+        .num_byte_classes = json::lex_table.num_byte_classes,
+        .byte_classes = json::lex_table.byte_classes,
+        .initial_states = json::lex_table.initial_states,
+        .merge_table = json::lex_table.merge_table,
+        .final_states = reinterpret_cast<const pareas::HostLexer::TokenType*>(json::lex_table.final_states),
+        .identity_state = json::lex_table.identity_state,
+        .num_dfa_states = json::lex_table.num_dfa_states,
+        .dfa_transitions = json::lex_table.dfa_transitions,
+        .dfa_final_states = reinterpret_cast<const pareas::HostLexer::TokenType*>(json::lex_table.dfa_final_states),
+        .dfa_start_state = json::lex_table.dfa_start_state,
+    };
+}
+
 futhark::UniqueLexTable upload_lex_table(futhark_context* ctx) {
-    auto initial_state = futhark::UniqueArray<uint16_t, 1>(
+    auto byte_class = futhark::UniqueArray<uint8_t, 1>(
+        ctx,
+        reinterpret_cast<const json::LexTable::ByteClass*>(json::lex_table.byte_classes),
+        json::LexTable::NUM_BYTES
+    );
+
+    auto initial_state = futhark::UniqueArray<json::LexTable::State, 1>(
         ctx,
         reinterpret_cast<const json::LexTable::State*>(json::lex_table.initial_states),
-        json::LexTable::NUM_INITIAL_STATES
+        json::lex_table.num_byte_classes
     );
 
-    auto merge_table = futhark::UniqueArray<uint16_t, 2>(
+    auto merge_table = futhark::UniqueArray<json::LexTable::State, 2>(
         ctx,
         reinterpret_cast<const json::LexTable::State*>(json::lex_table.merge_table),
         json::lex_table.n,
@@ -189,6 +434,7 @@ futhark::UniqueLexTable upload_lex_table(futhark_context* ctx) {
     int err = futhark_entry_mk_lex_table(
         ctx,
         &lex_table,
+        byte_class.get(),
         initial_state.get(),
         merge_table.get(),
         final_state.get()
@@ -251,16 +497,125 @@ void dump_dot(const JsonTree& j, std::ostream& os) {
     fmt::print(os, "}}\n");
 }
 
-JsonTree parse(futhark_context* ctx, const std::string& input, bool verbose_tree, pareas::Profiler& p, std::FILE* debug_log) {
+// Upload the input in blocks of `block_size` bytes, and summarize every block as soon as it is uploaded (see
+// `lexer.lex_summary`). Summaries do not depend on the preceding blocks, so there is no chain between blocks. The
+// summaries are then combined through the merge table on the host, which gives the state in which every block starts,
+// after which the blocks are lexed independently and their tokens are joined.
+//
+// Only on the GPU backends, where entry points are asynchronous, can the upload of a block overlap with summarizing
+// the previous one. On the c and multicore backends, entry points are synchronous: nothing overlaps, and this mode
+// only adds a pass over the input compared to lexing it at once. In either case, combining the summaries waits for
+// all blocks to be uploaded and summarized.
+futhark::UniqueArray<uint8_t, 1> lex_chunked(
+    futhark_context* ctx,
+    std::string_view input,
+    futhark::UniqueLexTable& lex_table,
+    size_t block_size,
+    pareas::Profiler& p
+) {
+    using State = json::LexTable::State;
+    assert(!input.empty());
+
+    auto blocks = std::vector<futhark::UniqueArray<uint8_t, 1>>();
+    auto summaries = std::vector<futhark::UniqueArray<State, 1>>();
+
+    p.begin();
+    for (size_t offset = 0; offset < input.size(); offset += block_size) {
+        auto size = std::min(block_size, input.size() - offset);
+        auto& block = blocks.emplace_back(ctx, reinterpret_cast<const uint8_t*>(input.data() + offset), size);
+
+        auto& summary = summaries.emplace_back(ctx);
+        int err = futhark_entry_json_lex_summary(ctx, &summary, block, lex_table);
+        if (err)
+            throw futhark::Error(ctx);
+    }
+    p.count("blocks", blocks.size());
+    p.end("upload and summarize");
+
+    // Compute the state before every block from the summaries, and the state after the last block.
+    p.begin();
+    auto merge = [](State a, State b) -> State {
+        constexpr const State mask = json::LexTable::PRODUCES_TOKEN_MASK - 1;
+        return json::lex_table.merge_table[(a & mask) * json::lex_table.n + (b & mask)] & mask;
+    };
+
+    auto host_summaries = std::vector<State>(summaries.size());
+    for (size_t i = 0; i < summaries.size(); ++i)
+        summaries[i].values(&host_summaries[i]);
+    if (futhark_context_sync(ctx))
+        throw futhark::Error(ctx);
+    summaries.clear();
+
+    auto prefixes = std::vector<State>(blocks.size() + 1);
+    prefixes[0] = json::lex_table.identity_state;
+    for (size_t i = 0; i < blocks.size(); ++i)
+        prefixes[i + 1] = merge(prefixes[i], host_summaries[i]);
+    p.end("stitch");
+
+    p.begin();
+    auto tokens = std::vector<futhark::UniqueArray<uint8_t, 1>>();
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        auto prefix = futhark::UniqueArray<State, 1>(ctx, &prefixes[i], 1);
+        auto carry = futhark::UniqueArray<State, 1>(ctx);
+        auto& block_tokens = tokens.emplace_back(ctx);
+        int err = futhark_entry_json_lex_block(ctx, &carry, &block_tokens, prefix, blocks[i], lex_table);
+        if (err)
+            throw futhark::Error(ctx);
+        blocks[i].clear();
+    }
+
+    auto final_state = futhark::UniqueArray<State, 1>(ctx, &prefixes.back(), 1);
+    auto& final_token = tokens.emplace_back(ctx);
+    int err = futhark_entry_json_lex_finish(ctx, &final_token, final_state, lex_table);
+    if (err)
+        throw futhark::Error(ctx);
+    p.end("lex");
+
+    // Join pairwise, so that every token is copied a logarithmic number of times.
+    p.begin();
+    while (tokens.size() > 1) {
+        auto joined = std::vector<futhark::UniqueArray<uint8_t, 1>>();
+        for (size_t i = 0; i + 1 < tokens.size(); i += 2) {
+            auto& pair = joined.emplace_back(ctx);
+            int err = futhark_entry_json_concat_tokens(ctx, &pair, tokens[i], tokens[i + 1]);
+            if (err)
+                throw futhark::Error(ctx);
+        }
+
+        if (tokens.size() % 2 != 0)
+            joined.push_back(std::move(tokens.back()));
+
+        tokens = std::move(joined);
+    }
+    p.end("join");
+
+    return std::move(tokens.front());
+}
+
+JsonTree parse(
+    futhark_context* ctx,
+    std::string_view input,
+    const pareas::HostLexer& host_lexer,
+    const pareas::LexerOptions& lexer_opts,
+    size_t upload_block_size,
+    bool verbose_tree,
+    pareas::Profiler& p,
+    std::FILE* debug_log
+) {
     auto debug_log_region = [&](const char* name) {
         if (debug_log)
             fmt::print(debug_log, "<<<{}>>>\n", name);
     };
 
+    // When lexing on the host, the input is not required on the device at all.
+    bool host_lex = lexer_opts.use_host(input.size());
+    // Inputs that fit in a single block are uploaded at once.
+    bool chunked = !host_lex && upload_block_size > 0 && input.size() > upload_block_size;
+
     debug_log_region("upload");
     p.begin();
     p.begin();
-    auto lex_table = upload_lex_table(ctx);
+    auto lex_table = host_lex ? futhark::UniqueLexTable(ctx) : upload_lex_table(ctx);
 
     auto sct = upload_strtab<futhark::UniqueStackChangeTable>(
         ctx,
@@ -277,9 +632,13 @@ JsonTree parse(futhark_context* ctx, const std::string& input, bool verbose_tree
     auto arity_array = futhark::UniqueArray<int32_t, 1>(ctx, json::arities, json::NUM_PRODUCTIONS);
     p.end("table");
 
-    p.begin();
-    auto input_array = futhark::UniqueArray<uint8_t, 1>(ctx, reinterpret_cast<const uint8_t*>(input.data()), input.size());
-    p.end("input");
+    auto input_array = futhark::UniqueArray<uint8_t, 1>(ctx);
+    if (!host_lex && !chunked) {
+        p.begin();
+        input_array = futhark::UniqueArray<uint8_t, 1>(ctx, reinterpret_cast<const uint8_t*>(input.data()), input.size());
+        p.count("bytes", input.size());
+        p.end("input");
+    }
     p.end("upload");
 
     p.begin();
@@ -287,9 +646,27 @@ JsonTree parse(futhark_context* ctx, const std::string& input, bool verbose_tree
     debug_log_region("tokenize");
     auto tokens = futhark::UniqueArray<uint8_t, 1>(ctx);
     p.measure("tokenize", [&]{
-        int err = futhark_entry_json_lex(ctx, &tokens, input_array, lex_table);
-        if (err)
-            throw futhark::Error(ctx);
+        if (host_lex) {
+            p.begin();
+            auto host_tokens = host_lexer.lex(input, lexer_opts);
+            p.end("host lex");
+
+            p.begin();
+            auto types = futhark::UniqueArray<uint8_t, 1>(ctx, host_tokens.types.data(), host_tokens.size());
+            p.end("token upload");
+
+            int err = futhark_entry_json_lex_host(ctx, &tokens, types);
+            if (err)
+                throw futhark::Error(ctx);
+        } else if (chunked) {
+            tokens = lex_chunked(ctx, input, lex_table, upload_block_size, p);
+            p.count("bytes", input.size());
+        } else {
+            int err = futhark_entry_json_lex(ctx, &tokens, input_array, lex_table);
+            if (err)
+                throw futhark::Error(ctx);
+        }
+        p.count("tokens", tokens.shape()[0]);
     });
     input_array.clear();
     lex_table.clear();
@@ -307,6 +684,7 @@ JsonTree parse(futhark_context* ctx, const std::string& input, bool verbose_tree
             throw futhark::Error(ctx);
         if (!valid)
             throw std::runtime_error("Parse error");
+        p.count("nodes", node_types.shape()[0]);
     });
     sct.clear();
     pt.clear();
@@ -370,6 +748,142 @@ JsonTree parse(futhark_context* ctx, const std::string& input, bool verbose_tree
     return ast;
 }
 
+// Validate the document at `path` without reading it as a whole: it is read, lexed and checked one window of
+// `window_size` bytes at a time. The state of the lexer and of the checks is carried from window to window on the
+// device, so memory use is bounded by the window size and the nesting depth of the document. This produces the
+// same verdict as `parse`, but no tree.
+void validate_stream(futhark_context* ctx, const char* path, size_t window_size, pareas::Profiler& p) {
+    using Clock = pareas::Profiler::Clock;
+
+    auto stream = pareas::InputStream(path);
+    auto buffer = std::make_unique<char[]>(window_size);
+
+    p.begin();
+    auto lex_table = upload_lex_table(ctx);
+    auto sct = upload_strtab<futhark::UniqueStackChangeTable>(
+        ctx,
+        json::stack_change_table,
+        futhark_entry_mk_stack_change_table
+    );
+    p.end("upload tables");
+
+    auto special_soi = static_cast<uint8_t>(json::Token::SPECIAL_SOI);
+    const uint8_t initial_prev[] = {special_soi, special_soi};
+
+    auto lex_carry = futhark::UniqueArray<json::LexTable::State, 1>(ctx, &json::lex_table.identity_state, 1);
+    auto prev = futhark::UniqueArray<uint8_t, 1>(ctx, initial_prev, 2);
+    // The stack and scopes start out empty. These are inputs of an entry point, so they have to be actual
+    // (empty) arrays rather than null handles.
+    auto stack = futhark::UniqueArray<json::Bracket, 1>(ctx, nullptr, 0);
+    auto scopes = futhark::UniqueArray<uint8_t, 1>(ctx, nullptr, 0);
+
+    bool valid = true;
+    bool structure_valid = true;
+
+    // Check a window of tokens, and carry the state over to the next window.
+    auto check_window = [&](const futhark::UniqueArray<uint8_t, 1>& tokens, bool last) {
+        auto old_prev = std::move(prev);
+        auto old_stack = std::move(stack);
+        auto old_scopes = std::move(scopes);
+        bool window_structure_valid;
+        int err = futhark_entry_json_check_window(
+            ctx,
+            &valid,
+            &window_structure_valid,
+            &prev,
+            &stack,
+            &scopes,
+            old_prev,
+            tokens,
+            last,
+            old_stack,
+            old_scopes,
+            sct
+        );
+        if (err)
+            throw futhark::Error(ctx);
+
+        structure_valid = structure_valid && window_structure_valid;
+    };
+
+    size_t total_bytes = 0;
+    size_t windows = 0;
+
+    p.begin();
+    // A parse error takes precedence over a structure error, like in `parse`, so only stop early on the former.
+    while (valid) {
+        auto start = Clock::now();
+
+        size_t size = stream.read(buffer.get(), window_size);
+        if (size == 0)
+            break;
+
+        auto window = futhark::UniqueArray<uint8_t, 1>(ctx, reinterpret_cast<const uint8_t*>(buffer.get()), size);
+        auto tokens = futhark::UniqueArray<uint8_t, 1>(ctx);
+        auto old_lex_carry = std::move(lex_carry);
+        int err = futhark_entry_json_lex_block(ctx, &lex_carry, &tokens, old_lex_carry, window, lex_table);
+        if (err)
+            throw futhark::Error(ctx);
+
+        check_window(tokens, false);
+
+        // The validity results are only available once the window is processed, so no explicit sync is needed.
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+        fmt::print(
+            std::cerr,
+            "Window {}: {} bytes, {} tokens, {:.3f} GB/s\n",
+            windows,
+            size,
+            tokens.shape()[0],
+            static_cast<double>(size) / elapsed.count()
+        );
+
+        total_bytes += size;
+        ++windows;
+    }
+
+    if (valid) {
+        // The final token is only known at the end of the input. An empty input has no tokens at all.
+        auto tokens = futhark::UniqueArray<uint8_t, 1>(ctx, initial_prev, 0);
+        if (total_bytes > 0) {
+            int err = futhark_entry_json_lex_finish(ctx, &tokens, lex_carry, lex_table);
+            if (err)
+                throw futhark::Error(ctx);
+        }
+
+        check_window(tokens, true);
+    }
+
+    p.count("bytes", total_bytes);
+    p.count("windows", windows);
+    p.end("stream");
+
+    if (!valid)
+        throw std::runtime_error("Parse error");
+    else if (!structure_valid)
+        throw std::runtime_error("Invalid structure");
+}
+
+void bench(futhark_context* ctx, std::string_view input, const pareas::HostLexer& host_lexer, const Options& opts) {
+    auto stats = pareas::ProfileStatistics();
+
+    for (unsigned i = 0; i < opts.warmup + opts.bench; ++i) {
+        auto p = pareas::Profiler(9999);
+        p.set_sync_mode(opts.profile_sync);
+        p.set_sync_callback([ctx]{
+            if (futhark_context_sync(ctx))
+                throw futhark::Error(ctx);
+        });
+
+        parse(ctx, input, host_lexer, opts.lexer, opts.upload_block_size, opts.verbose_tree, p, opts.futhark_debug_extra ? stderr : nullptr);
+
+        if (i >= opts.warmup)
+            stats.add(p);
+    }
+
+    stats.dump(std::cout, opts.profile_format, opts.throughput ? input.size() : 0);
+}
+
 int main(int argc, char* argv[]) {
     Options opts;
     if (!parse_options(&opts, argc, argv)) {
@@ -381,16 +895,21 @@ int main(int argc, char* argv[]) {
     }
 
     auto p = pareas::Profiler(9999);
-
-    auto in = std::ifstream(opts.input_path, std::ios::binary);
-    if (!in) {
-        fmt::print(std::cerr, "Error: Failed to open input file '{}'\n", opts.input_path);
-        return EXIT_FAILURE;
+    p.set_sync_mode(opts.profile_sync);
+
+    // In streaming mode, the input is read while it is processed.
+    auto input = std::optional<pareas::InputFile>();
+    if (opts.stream_window_size == 0) {
+        p.begin();
+        try {
+            input.emplace(opts.input_path);
+        } catch (const std::system_error& err) {
+            fmt::print(std::cerr, "Error: {}\n", err.what());
+            return EXIT_FAILURE;
+        }
+        p.end("read input");
     }
 
-    auto input = std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
-    in.close();
-
     p.begin();
     auto config = futhark::ContextConfig(futhark_context_config_new());
 
@@ -415,13 +934,23 @@ int main(int argc, char* argv[]) {
     });
     p.end("context init");
 
+    // The host lexer tables are derived once, rather than for every parse.
+    auto host_lexer = pareas::HostLexer(host_lex_tables());
+
     try {
-        auto ast = parse(ctx.get(), input, opts.verbose_tree, p, opts.futhark_debug_extra ? stderr : nullptr);
+        if (opts.stream_window_size > 0) {
+            validate_stream(ctx.get(), opts.input_path, opts.stream_window_size, p);
+            p.dump(std::cout, opts.profile_format);
+        } else if (opts.bench > 0) {
+            bench(ctx.get(), input->contents(), host_lexer, opts);
+        } else {
+            auto ast = parse(ctx.get(), input->contents(), host_lexer, opts.lexer, opts.upload_block_size, opts.verbose_tree, p, opts.futhark_debug_extra ? stderr : nullptr);
 
-        if (opts.dump_dot)
-            dump_dot(ast, std::cout);
-        else
-            p.dump(std::cout);
+            if (opts.dump_dot)
+                dump_dot(ast, std::cout);
+            else
+                p.dump(std::cout, opts.profile_format);
+        }
 
         if (opts.futhark_profile) {
             auto report = MallocPtr<char>(futhark_context_report(ctx.get()));
@@ -0,0 +1,44 @@
+#include "pareas/lpg/lexer/byte_classes.hpp"
+
+#include <optional>
+#include <cassert>
+
+namespace pareas::lexer {
+    ByteClasses::ByteClasses():
+        num_classes(1) {
+        this->byte_class.fill(0);
+    }
+
+    void ByteClasses::refine(const ByteSet& bytes) {
+        // Every existing class is split in a part that is inside `bytes` and a part that is outside of it.
+        auto new_class = std::array<std::optional<ClassIndex>, 2 * NUM_BYTES>();
+        size_t num_new_classes = 0;
+
+        for (size_t byte = 0; byte < NUM_BYTES; ++byte) {
+            auto& index = new_class[this->byte_class[byte] * 2 + bytes.test(byte)];
+            if (!index.has_value())
+                index = num_new_classes++;
+            this->byte_class[byte] = index.value();
+        }
+
+        assert(num_new_classes <= NUM_BYTES);
+        this->num_classes = num_new_classes;
+    }
+
+    size_t ByteClasses::size() const {
+        return this->num_classes;
+    }
+
+    auto ByteClasses::operator[](uint8_t byte) const -> ClassIndex {
+        return this->byte_class[byte];
+    }
+
+    auto ByteClasses::classes_of(const ByteSet& bytes) const -> ByteSet {
+        auto classes = ByteSet();
+        for (size_t byte = 0; byte < NUM_BYTES; ++byte) {
+            if (bytes.test(byte))
+                classes.set(this->byte_class[byte]);
+        }
+        return classes;
+    }
+}
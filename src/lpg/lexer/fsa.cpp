@@ -1,17 +1,20 @@
 #include "pareas/lpg/lexer/fsa.hpp"
 #include "pareas/lpg/lexer/regex.hpp"
+#include "pareas/lpg/lexer/byte_classes.hpp"
 #include "pareas/lpg/lexer/lexical_grammar.hpp"
-#include "pareas/lpg/escape.hpp"
 #include "pareas/lpg/hash_util.hpp"
 
 #include <fmt/format.h>
 #include <fmt/ostream.h>
 
 #include <iostream>
-#include <deque>
 #include <unordered_map>
-#include <unordered_set>
+#include <map>
+#include <vector>
+#include <algorithm>
 #include <bitset>
+#include <array>
+#include <utility>
 #include <limits>
 #include <cassert>
 
@@ -21,67 +24,156 @@ using StateIndex = pareas::lexer::FiniteStateAutomaton::StateIndex;
 namespace {
     using namespace pareas::lexer;
 
-    struct StateSet {
-        std::unordered_set<StateIndex> states;
+    // A set of NFA states, sorted so that equal sets compare and hash equally.
+    using StateSet = std::vector<StateIndex>;
 
-        struct Hash {
-            size_t operator()(const StateSet& ss) const;
-        };
+    struct StateSetHash {
+        size_t operator()(const StateSet& ss) const {
+            return pareas::hash_range(ss.begin(), ss.end(), std::hash<StateIndex>{});
+        }
     };
 
-    size_t StateSet::Hash::operator()(const StateSet& ss) const {
-        // Need to make sure that the order doesn't matter for this hash.
-        return pareas::hash_order_independent_range(ss.states.begin(), ss.states.end(), std::hash<StateIndex>{});
-    }
+    // Subset construction of a DFA from an NFA. The epsilon closure and the (symbol-sorted) non-epsilon
+    // transitions of every NFA state are only computed once, and are shared between the DFAs constructed
+    // from different roots of the same NFA.
+    class SubsetConstruction {
+        using SymbolTransition = std::pair<Symbol, StateIndex>;
 
-    bool operator==(const StateSet& lhs, const StateSet& rhs) {
-        return lhs.states == rhs.states;
-    }
+        const FiniteStateAutomaton& nfa;
+
+        // Non-epsilon transitions of every NFA state, sorted by symbol.
+        std::vector<std::vector<SymbolTransition>> transitions;
+
+        // Epsilon closure of every NFA state, computed on first use.
+        std::vector<StateSet> closures;
+        std::vector<bool> closure_computed;
 
-    void closure(const FiniteStateAutomaton& fsa, StateSet& ss) {
-        auto queue = std::deque<StateIndex>();
-        for (auto state : ss.states)
-            queue.push_back(state);
+        // Scratch space for computing closures.
+        std::vector<bool> visited;
+        std::vector<StateIndex> stack;
 
-        auto enqueue = [&](StateIndex state) {
-            auto inserted = ss.states.insert(state).second;
-            if (inserted)
-                queue.push_back(state);
-        };
+        // Scratch space for the states reachable from a set on every symbol.
+        std::array<StateSet, FiniteStateAutomaton::MAX_SYM + 1> moves;
 
-        while (!queue.empty()) {
-            auto src = queue.front();
-            queue.pop_front();
+    public:
+        explicit SubsetConstruction(const FiniteStateAutomaton& nfa);
 
-            for (const auto& [maybe_sym, dst, _] : fsa[src].transitions) {
-                if (!maybe_sym.has_value())
-                    enqueue(dst);
+        // Construct the DFA states reachable from `nfa_start`, where the state corresponding to its closure
+        // is `dfa_start`.
+        void run(const LexicalGrammar* g, FiniteStateAutomaton& dfa, StateIndex nfa_start, StateIndex dfa_start);
+
+    private:
+        const StateSet& closure(StateIndex state);
+    };
+
+    SubsetConstruction::SubsetConstruction(const FiniteStateAutomaton& nfa):
+        nfa(nfa),
+        transitions(nfa.num_states()),
+        closures(nfa.num_states()),
+        closure_computed(nfa.num_states(), false),
+        visited(nfa.num_states(), false) {
+        for (StateIndex src = 0; src < nfa.num_states(); ++src) {
+            auto& transitions = this->transitions[src];
+            for (const auto& [maybe_sym, dst, _] : nfa[src].transitions) {
+                if (maybe_sym.has_value())
+                    transitions.push_back({maybe_sym.value(), dst});
             }
+
+            std::sort(transitions.begin(), transitions.end());
         }
     }
 
-    std::unordered_set<Symbol> follow(const FiniteStateAutomaton& fsa, const StateSet& ss) {
-        // Epsilon-transitions should already be dealt with at this point
-        auto syms = std::unordered_set<Symbol>();
-        for (auto src : ss.states) {
-            for (const auto& [maybe_sym, dst, _] : fsa[src].transitions) {
-                if (maybe_sym.has_value())
-                    syms.insert(maybe_sym.value());
+    const StateSet& SubsetConstruction::closure(StateIndex state) {
+        auto& closure = this->closures[state];
+        if (this->closure_computed[state])
+            return closure;
+
+        this->stack.push_back(state);
+        this->visited[state] = true;
+
+        while (!this->stack.empty()) {
+            auto src = this->stack.back();
+            this->stack.pop_back();
+            closure.push_back(src);
+
+            for (const auto& [maybe_sym, dst, _] : this->nfa[src].transitions) {
+                if (!maybe_sym.has_value() && !this->visited[dst]) {
+                    this->visited[dst] = true;
+                    this->stack.push_back(dst);
+                }
             }
         }
-        return syms;
+
+        for (auto s : closure)
+            this->visited[s] = false;
+
+        std::sort(closure.begin(), closure.end());
+        this->closure_computed[state] = true;
+        return closure;
     }
 
-    StateSet move(const FiniteStateAutomaton& fsa, const StateSet& ss, Symbol move_sym) {
-        auto after_move = StateSet{};
-        for (auto src : ss.states) {
-            for (const auto& [sym, dst, _] : fsa[src].transitions) {
-                if (sym == move_sym)
-                    after_move.states.insert(dst);
+    void SubsetConstruction::run(const LexicalGrammar* g, FiniteStateAutomaton& dfa, StateIndex nfa_start, StateIndex dfa_start) {
+        auto seen = std::unordered_map<StateSet, StateIndex, StateSetHash>();
+        // The sets of the DFA states constructed here, in order of construction. Elements of unordered_map
+        // are not moved, so these can point into `seen`.
+        auto sets = std::vector<std::pair<const StateSet*, StateIndex>>();
+
+        {
+            auto it = seen.insert({this->closure(nfa_start), dfa_start}).first;
+            sets.push_back({&it->first, dfa_start});
+        }
+
+        auto syms = std::vector<Symbol>();
+
+        for (size_t i = 0; i < sets.size(); ++i) {
+            auto [ss, src] = sets[i];
+
+            // Compute the states reachable on every symbol at once, including the epsilon closure.
+            for (auto nfa_src : *ss) {
+                for (const auto& [sym, dst] : this->transitions[nfa_src]) {
+                    auto& move = this->moves[sym];
+                    if (move.empty())
+                        syms.push_back(sym);
+
+                    const auto& closure = this->closure(dst);
+                    move.insert(move.end(), closure.begin(), closure.end());
+                }
+            }
+
+            std::sort(syms.begin(), syms.end());
+            for (auto sym : syms) {
+                auto& move = this->moves[sym];
+                std::sort(move.begin(), move.end());
+                move.erase(std::unique(move.begin(), move.end()), move.end());
+
+                auto it = seen.find(move);
+                if (it == seen.end()) {
+                    it = seen.insert({move, dfa.add_state()}).first;
+                    sets.push_back({&it->first, it->second});
+                }
+
+                dfa.add_transition(src, it->second, sym);
+                move.clear();
             }
+
+            syms.clear();
         }
 
-        return after_move;
+        for (auto [ss, dfa_index] : sets) {
+            auto& dfa_state = dfa[dfa_index];
+
+            for (auto nfa_index : *ss) {
+                const auto& nfa_state = this->nfa[nfa_index];
+
+                if (nfa_state.lexeme && dfa_state.lexeme) {
+                    if (g->lexeme_id(nfa_state.lexeme) < g->lexeme_id(dfa_state.lexeme)) {
+                        dfa_state.lexeme = nfa_state.lexeme;
+                    }
+                } else if (nfa_state.lexeme) {
+                    dfa_state.lexeme = nfa_state.lexeme;
+                }
+            }
+        }
     }
 }
 
@@ -154,7 +246,7 @@ namespace pareas::lexer {
                 auto style = produces_lexeme ? ", color=blue" : "";
 
                 if (maybe_sym.has_value()) {
-                    fmt::print(os, "    state{} -> state{} [label=\"{:q}\"{}];\n", src, dst, EscapeFormatter{maybe_sym.value()}, style);
+                    fmt::print(os, "    state{} -> state{} [label=\"class {}\"{}];\n", src, dst, maybe_sym.value(), style);
                 } else {
                     fmt::print(os, "    state{} -> state{} [label=\"Ɛ\"{}];\n", src, dst, style);
                 }
@@ -165,68 +257,126 @@ namespace pareas::lexer {
     }
 
     void FiniteStateAutomaton::to_dfa(const LexicalGrammar* g, FiniteStateAutomaton& dfa, StateIndex nfa_start, StateIndex dfa_start) const {
-        auto seen = std::unordered_map<StateSet, StateIndex, StateSet::Hash>();
-        auto queue = std::deque<StateSet>();
+        SubsetConstruction(*this).run(g, dfa, nfa_start, dfa_start);
+    }
 
-        auto enqueue = [&](const StateSet& ss) {
-            auto it = seen.find(ss);
-            if (it != seen.end())
-                return it->second;
+    FiniteStateAutomaton FiniteStateAutomaton::minimize() const {
+        size_t n = this->num_states();
 
-            auto state = dfa.add_state();
-            seen.insert(it, {ss, state});
-            queue.push_back(ss);
-            return state;
-        };
+        // States that cannot be reached from the start state are removed. This includes the roots that are
+        // only used to construct the transitions of lexemes with a 'preceded by' list.
+        auto reachable = std::vector<bool>(n, false);
+        {
+            auto stack = std::vector<StateIndex>{START};
+            reachable[START] = true;
+            reachable[REJECT] = true;
+
+            while (!stack.empty()) {
+                auto src = stack.back();
+                stack.pop_back();
+
+                for (const auto& t : this->states[src].transitions) {
+                    if (!reachable[t.dst]) {
+                        reachable[t.dst] = true;
+                        stack.push_back(t.dst);
+                    }
+                }
+            }
+        }
 
+        // Moore's partition refinement: start with the partition by lexeme, and repeatedly split blocks
+        // whose states have transitions into different blocks until nothing changes. The reject and start
+        // states are placed in a block of their own, so that they can keep their index. Unreachable states
+        // are ignored.
+        auto block = std::vector<StateIndex>(n);
+        size_t num_blocks = 0;
         {
-            auto start_ss = StateSet{{nfa_start}};
-            // Move over all epsilon-transitions
-            closure(*this, start_ss);
+            auto lexeme_blocks = std::unordered_map<const Lexeme*, StateIndex>();
+            for (StateIndex state = 0; state < n; ++state) {
+                if (!reachable[state])
+                    continue;
 
-            seen.insert({start_ss, dfa_start});
-            queue.push_back(start_ss);
-        }
+                if (state == REJECT || state == START) {
+                    block[state] = num_blocks++;
+                    continue;
+                }
 
-        while (!queue.empty()) {
-            auto ss = queue.front();
-            auto src = seen[ss];
-            queue.pop_front();
-            auto follow_set = follow(*this, ss);
-
-            for (auto sym : follow_set) {
-                auto new_ss = move(*this, ss, sym);
-                // Move over all epsilon-transitions
-                closure(*this, new_ss);
-                auto dst = enqueue(new_ss);
-                dfa.add_transition(src, dst, sym);
+                auto [it, inserted] = lexeme_blocks.insert({this->states[state].lexeme, num_blocks});
+                if (inserted)
+                    ++num_blocks;
+                block[state] = it->second;
             }
         }
 
-        for (const auto& [ss, dfa_index] : seen) {
-            auto& dfa_state = dfa[dfa_index];
+        while (true) {
+            // The signature of a state consists of its block and the block and flag of the transition on every symbol.
+            auto signatures = std::map<std::vector<size_t>, StateIndex>();
+            auto new_block = std::vector<StateIndex>(n);
 
-            for (auto nfa_index : ss.states) {
-                const auto& nfa_state = this->states[nfa_index];
+            for (StateIndex state = 0; state < n; ++state) {
+                if (!reachable[state])
+                    continue;
 
-                if (nfa_state.lexeme && dfa_state.lexeme) {
-                    if (g->lexeme_id(nfa_state.lexeme) < g->lexeme_id(dfa_state.lexeme)) {
-                        dfa_state.lexeme = nfa_state.lexeme;
-                    }
-                } else if (nfa_state.lexeme) {
-                    dfa_state.lexeme = nfa_state.lexeme;
+                auto signature = std::vector<size_t>{block[state]};
+                auto transitions = this->states[state].transitions;
+                std::sort(transitions.begin(), transitions.end(), [](const auto& a, const auto& b) {
+                    return a.maybe_sym < b.maybe_sym;
+                });
+
+                for (const auto& [sym, dst, produces_lexeme] : transitions) {
+                    assert(sym.has_value()); // Not a DFA
+                    signature.push_back(sym.value());
+                    signature.push_back(block[dst]);
+                    signature.push_back(produces_lexeme);
                 }
+
+                new_block[state] = signatures.insert({std::move(signature), signatures.size()}).first->second;
+            }
+
+            bool stable = signatures.size() == num_blocks;
+            block = std::move(new_block);
+            num_blocks = signatures.size();
+
+            if (stable)
+                break;
+        }
+
+        // Number the blocks in order of their first state. As the reject and start states have blocks of
+        // their own, they keep their index.
+        auto index = std::vector<std::optional<StateIndex>>(num_blocks);
+        auto representatives = std::vector<StateIndex>();
+        for (StateIndex state = 0; state < n; ++state) {
+            if (reachable[state] && !index[block[state]].has_value()) {
+                index[block[state]] = representatives.size();
+                representatives.push_back(state);
             }
         }
+
+        assert(index[block[REJECT]] == REJECT);
+        assert(index[block[START]] == START);
+
+        auto dfa = FiniteStateAutomaton();
+        while (dfa.num_states() < representatives.size())
+            dfa.add_state();
+
+        for (StateIndex dst_state = 0; dst_state < representatives.size(); ++dst_state) {
+            const auto& [lexeme, transitions] = this->states[representatives[dst_state]];
+            dfa.states[dst_state].lexeme = lexeme;
+            for (const auto& [sym, dst, produces_lexeme] : transitions) {
+                dfa.add_transition(dst_state, index[block[dst]].value(), sym, produces_lexeme);
+            }
+        }
+
+        return dfa;
     }
 
-    FiniteStateAutomaton FiniteStateAutomaton::build_lexer_dfa(const LexicalGrammar* g) {
+    FiniteStateAutomaton FiniteStateAutomaton::build_lexer_dfa(const LexicalGrammar* g, const ByteClasses& classes) {
         auto nfa = FiniteStateAutomaton();
 
         auto succ_nfa_roots = std::unordered_map<const Lexeme*, StateIndex>();
         for (const auto& lexeme : g->lexemes) {
             auto regex_start = nfa.add_state();
-            auto regex_end = lexeme.regex->compile(nfa, regex_start);
+            auto regex_end = lexeme.regex->compile(nfa, regex_start, classes);
             nfa.states[regex_end].lexeme = &lexeme;
 
             if (lexeme.preceded_by.empty()) {
@@ -259,9 +409,10 @@ namespace pareas::lexer {
 
         // Convert the NFA into a DFA, for each root (including start).
         auto dfa = FiniteStateAutomaton();
+        auto subset_construction = SubsetConstruction(nfa);
 
         // First do the nfa start state. This should attach to the DFA's start state.
-        nfa.to_dfa(g, dfa, START, START);
+        subset_construction.run(g, dfa, START, START);
 
         // Handle each of the successor roots.
         auto succ_dfa_roots = std::unordered_map<const Lexeme*, StateIndex>();
@@ -269,7 +420,7 @@ namespace pareas::lexer {
             auto dfa_root = dfa.add_state();
             succ_dfa_roots.insert({lexeme, dfa_root});
 
-            nfa.to_dfa(g, dfa, nfa_root, dfa_root);
+            subset_construction.run(g, dfa, nfa_root, dfa_root);
         }
 
         // Now its time to add the lexer loop. For each symbol of each final state that does
@@ -293,7 +444,7 @@ namespace pareas::lexer {
                 outgoing.set(t.maybe_sym.value());
             }
 
-            for (size_t sym = 0; sym < outgoing.size(); ++sym) {
+            for (size_t sym = 0; sym < classes.size(); ++sym) {
                 if (outgoing.test(sym))
                     continue;
 
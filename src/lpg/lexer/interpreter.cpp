@@ -12,7 +12,7 @@ namespace pareas::lexer {
         auto states = std::vector<ParallelLexer::StateIndex>();
 
         for (auto c : input) {
-            auto state = this->lexer->initial_states[c];
+            auto state = this->lexer->initial_state(c);
             states.push_back(state.result_state);
             if (state.produces_lexeme) {
                 auto t = this->lexer->final_states[ParallelLexer::START];
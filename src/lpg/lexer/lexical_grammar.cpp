@@ -19,6 +19,14 @@ namespace pareas::lexer {
         }
     }
 
+    ByteClasses LexicalGrammar::byte_classes() const {
+        auto classes = ByteClasses();
+        for (const auto& lexeme : this->lexemes) {
+            lexeme.regex->refine_byte_classes(classes);
+        }
+        return classes;
+    }
+
     void LexicalGrammar::validate(ErrorReporter& er) const {
         // Empty tokens will mess up the lexer, so check here that there are none.
         // Checking here will allow us to catch all of them at once.
@@ -3,10 +3,21 @@
 #include "pareas/lpg/hash_util.hpp"
 
 #include <fmt/ostream.h>
+#include <fmt/chrono.h>
 
 #include <algorithm>
 #include <unordered_map>
+#include <map>
+#include <utility>
+#include <vector>
 #include <queue>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <stdexcept>
+#include <bit>
 #include <cassert>
 
 namespace {
@@ -16,11 +27,24 @@ namespace {
     using StateIndex = ParallelLexer::StateIndex;
     using Transition = ParallelLexer::Transition;
 
+    using Clock = std::chrono::steady_clock;
+
+    std::chrono::microseconds elapsed_since(Clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+    }
+
     struct ParallelState {
         std::vector<Transition> transitions;
+        // Cached hash of the transitions, as states are hashed and compared many times during construction.
+        size_t hash;
 
-        ParallelState(size_t states);
-        void merge(const ParallelState& other);
+        explicit ParallelState(size_t states);
+
+        // Recompute the cached hash, which is required after modifying the transitions directly.
+        void rehash();
+
+        // Set this state to the composition of `first` and `second`. All states must have the same size.
+        void merge(const ParallelState& first, const ParallelState& second);
 
         struct Hash {
             size_t operator()(const ParallelState& ps) const;
@@ -28,17 +52,27 @@ namespace {
     };
 
     ParallelState::ParallelState(size_t states):
-        transitions(states) {
+        transitions(states), hash(0) {
+        this->rehash();
+    }
+
+    void ParallelState::rehash() {
+        this->hash = 0;
+        for (auto state : this->transitions) {
+            this->hash = hash_combine(this->hash, state.result_state);
+            this->hash = hash_combine(this->hash, state.produces_lexeme);
+        }
     }
 
-    void ParallelState::merge(const ParallelState& other) {
-        for (auto& state : this->transitions) {
-            state = other.transitions[state.result_state];
+    void ParallelState::merge(const ParallelState& first, const ParallelState& second) {
+        for (size_t i = 0; i < this->transitions.size(); ++i) {
+            this->transitions[i] = second.transitions[first.transitions[i].result_state];
         }
+        this->rehash();
     }
 
     bool operator==(const ParallelState& lhs, const ParallelState& rhs) {
-        return std::equal(
+        return lhs.hash == rhs.hash && std::equal(
             lhs.transitions.begin(),
             lhs.transitions.end(),
             rhs.transitions.begin(),
@@ -50,12 +84,106 @@ namespace {
     }
 
     size_t ParallelState::Hash::operator()(const ParallelState& ps) const {
-        size_t hash = 0;
-        for (auto state : ps.transitions) {
-            hash = hash_combine(hash, state.result_state);
-            hash = hash_combine(hash, state.produces_lexeme);
+        return ps.hash;
+    }
+
+    // Table to intern parallel states, into which multiple threads may insert at once. States are distributed
+    // over shards by their hash, each of which is protected by its own mutex.
+    // The order in which threads insert states is not deterministic, so new states are first given a provisional
+    // index. `renumber` then assigns the final indices in order of first use.
+    class StateTable {
+        constexpr const static size_t NUM_SHARDS = 64;
+
+        struct Entry {
+            StateIndex index;
+            size_t first_use;
+        };
+
+        using Map = std::unordered_map<ParallelState, Entry, ParallelState::Hash>;
+
+        struct Shard {
+            std::mutex mutex;
+            Map states;
+            // States inserted since the last renumbering. Elements of unordered_map are not moved, so these
+            // can point into `states`.
+            std::vector<Map::value_type*> inserted;
+        };
+
+        std::unique_ptr<Shard[]> shards;
+        std::atomic<StateIndex> next_index;
+
+    public:
+        StateTable();
+
+        // Return the (possibly provisional) index of `ps`, and insert it if it is not yet present. `use` orders
+        // the calls made since the last renumbering.
+        StateIndex intern(const ParallelState& ps, size_t use);
+
+        // Assign final indices to the states inserted since the last renumbering, and append them to `states`.
+        // Returns the final index of every provisional index, offset by the number of states before.
+        std::vector<StateIndex> renumber(std::vector<ParallelState>& states);
+    };
+
+    StateTable::StateTable():
+        shards(std::make_unique<Shard[]>(NUM_SHARDS)), next_index(0) {
+    }
+
+    StateIndex StateTable::intern(const ParallelState& ps, size_t use) {
+        auto& shard = this->shards[(ps.hash ^ (ps.hash >> 32)) % NUM_SHARDS];
+        auto lock = std::scoped_lock(shard.mutex);
+
+        auto [it, inserted] = shard.states.try_emplace(ps, Entry{0, use});
+        if (inserted) {
+            it->second.index = this->next_index++;
+            shard.inserted.push_back(&*it);
+        } else {
+            it->second.first_use = std::min(it->second.first_use, use);
+        }
+
+        return it->second.index;
+    }
+
+    std::vector<StateIndex> StateTable::renumber(std::vector<ParallelState>& states) {
+        auto inserted = std::vector<Map::value_type*>();
+        for (size_t i = 0; i < NUM_SHARDS; ++i) {
+            auto& shard = this->shards[i];
+            inserted.insert(inserted.end(), shard.inserted.begin(), shard.inserted.end());
+            shard.inserted.clear();
         }
-        return hash;
+
+        std::sort(inserted.begin(), inserted.end(), [](const auto* lhs, const auto* rhs) {
+            return lhs->second.first_use < rhs->second.first_use;
+        });
+
+        StateIndex base = states.size();
+        auto final_index = std::vector<StateIndex>(inserted.size());
+        for (auto* kv : inserted) {
+            auto& [ps, entry] = *kv;
+            final_index[entry.index - base] = states.size();
+            entry.index = states.size();
+            states.push_back(ps);
+        }
+
+        return final_index;
+    }
+
+    // Invoke `f(i)` for `i` in [0, n), distributed over at most `threads` threads.
+    template <typename F>
+    void parallel_for(size_t n, unsigned threads, F f) {
+        auto next = std::atomic<size_t>(0);
+        auto work = [&] {
+            for (size_t i; (i = next++) < n;)
+                f(i);
+        };
+
+        auto workers = std::vector<std::thread>();
+        for (size_t i = 1; i < std::min<size_t>(threads, n); ++i)
+            workers.emplace_back(work);
+
+        work();
+
+        for (auto& worker : workers)
+            worker.join();
     }
 }
 
@@ -110,26 +238,41 @@ namespace pareas::lexer {
         return this->num_states;
     }
 
-    ParallelLexer::ParallelLexer(const LexicalGrammar* g) {
-        auto dfa = FiniteStateAutomaton::build_lexer_dfa(g);
+    ParallelLexer::ParallelLexer(const LexicalGrammar* g, unsigned threads):
+        byte_classes(g->byte_classes()) {
+        auto start = Clock::now();
+        auto unminimized_dfa = FiniteStateAutomaton::build_lexer_dfa(g, this->byte_classes);
+        this->timings.dfa_construction = elapsed_since(start);
+
+        start = Clock::now();
+        auto dfa = unminimized_dfa.minimize();
+        this->timings.dfa_minimization = elapsed_since(start);
+
+        this->unminimized_dfa_states = unminimized_dfa.num_states();
+        this->dfa_states = dfa.num_states();
+
+        // Missing transitions lead to the reject state, as in the initial parallel states below.
+        this->dfa_transitions.resize(dfa.num_states() * this->byte_classes.size());
+        this->dfa_final_states.resize(dfa.num_states());
+        for (size_t src = 0; src < dfa.num_states(); ++src) {
+            for (const auto [sym, dst, produces_lexeme] : dfa[src].transitions) {
+                assert(sym.has_value()); // Not a DFA
+                this->dfa_transitions[src * this->byte_classes.size() + sym.value()] = {dst, produces_lexeme};
+            }
+            this->dfa_final_states[src] = dfa[src].lexeme;
+        }
 
-        auto seen = std::unordered_map<ParallelState, StateIndex, ParallelState::Hash>();
-        auto states = std::vector<ParallelState>();
-        auto transitions = std::vector<Transition>();
+        start = Clock::now();
+        if (threads == 0)
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
 
-        auto enqueue = [&](ParallelState&& ps) {
-            auto [it, inserted] = seen.insert({std::move(ps), states.size()});
-            if (inserted) {
-                states.push_back(it->first);
-                this->merge_table.resize(it->second + 1);
-            }
-            return it->second;
-        };
+        auto table = StateTable();
+        auto states = std::vector<ParallelState>();
 
-        // Insert the initial states, we need to insert one for every character.
+        // Insert the initial states, we need to insert one for every byte class.
         // States indices of the DFA are mapped to the initial parallel states indices.
         {
-            auto initial_states = std::vector<ParallelState>(FiniteStateAutomaton::MAX_SYM + 1, ParallelState(dfa.num_states()));
+            auto initial_states = std::vector<ParallelState>(this->byte_classes.size(), ParallelState(dfa.num_states()));
             for (size_t src = 0; src < dfa.num_states(); ++src) {
                 for (const auto [sym, dst, produces_lexeme] : dfa[src].transitions) {
                     assert(sym.has_value()); // Not a DFA
@@ -138,61 +281,249 @@ namespace pareas::lexer {
                 }
             }
 
+            // Add the identity mapping, which is required for futhark's scan operation.
+            auto identity = ParallelState(dfa.num_states());
+            for (size_t i = 0; i < identity.transitions.size(); ++i) {
+                identity.transitions[i].result_state = i;
+            }
+
+            // These are interned from a single thread, so their provisional indices are final.
             this->initial_states.resize(initial_states.size());
             for (size_t sym = 0; sym < initial_states.size(); ++sym) {
                 auto& state = initial_states[sym];
+                state.rehash();
                 this->initial_states[sym].produces_lexeme = state.transitions[START].produces_lexeme;
-                this->initial_states[sym].result_state = enqueue(std::move(state));
+                this->initial_states[sym].result_state = table.intern(state, sym);
+            }
+
+            identity.rehash();
+            this->identity_state_index = table.intern(identity, initial_states.size());
+            table.renumber(states);
+        }
+
+        // Every state is merged with itself and all states before it, in both orders, until no new states
+        // are found. This is done in batches of consecutive states, the merges of which are computed in
+        // parallel. The merges of state i are stored in a batch from offset i² - begin², so that a batch of
+        // states [begin, end) requires end² - begin² results.
+        constexpr const size_t MAX_MERGES_PER_BATCH = 1 << 22;
+        auto results = std::vector<StateIndex>();
+
+        for (StateIndex begin = 0; begin < states.size();) {
+            auto end = begin + 1;
+            while (end < states.size() && (end + 1) * (end + 1) - begin * begin <= MAX_MERGES_PER_BATCH)
+                ++end;
+
+            results.resize(end * end - begin * begin);
+
+            parallel_for(end - begin, threads, [&](size_t row) {
+                StateIndex i = begin + row;
+                size_t offset = i * i - begin * begin;
+                auto ps = ParallelState(dfa.num_states());
+
+                auto merge = [&](StateIndex first, StateIndex second, size_t use) {
+                    // We need to handle the identity stage separately here, as we
+                    // normally just copy the produces_lexeme property from the right hand site,
+                    // but if the right hand site is the identity state thats not correct.
+                    if (first == this->identity_state_index) {
+                        results[use] = second;
+                    } else if (second == this->identity_state_index) {
+                        results[use] = first;
+                    } else {
+                        ps.merge(states[first], states[second]);
+                        results[use] = table.intern(ps, use);
+                    }
+                };
+
+                for (StateIndex j = 0; j <= i; ++j)
+                    merge(i, j, offset + j);
+
+                for (StateIndex j = 0; j < i; ++j)
+                    merge(j, i, offset + i + 1 + j);
+            });
+
+            StateIndex base = states.size();
+            auto final_index = table.renumber(states);
+            this->merge_table.resize(states.size());
+
+            auto store = [&](StateIndex first, StateIndex second, size_t use) {
+                auto result = results[use] < base ? results[use] : final_index[results[use] - base];
+                bool produces_lexeme = states[result].transitions[START].produces_lexeme;
+                this->merge_table(first, second) = {result, produces_lexeme};
+            };
+
+            for (StateIndex i = begin; i < end; ++i) {
+                size_t offset = i * i - begin * begin;
+                for (StateIndex j = 0; j <= i; ++j)
+                    store(i, j, offset + j);
+
+                for (StateIndex j = 0; j < i; ++j)
+                    store(j, i, offset + i + 1 + j);
             }
+
+            begin = end;
+        }
+
+        // Compute the final state mapping
+        this->final_states.resize(states.size(), nullptr);
+        for (StateIndex i = 0; i < states.size(); ++i) {
+            this->final_states[i] = dfa[states[i].transitions[START].result_state].lexeme;
         }
 
-        // Add the identity mapping, which is required for futhark's scan operation.
+        this->unminimized_states = states.size();
+        this->timings.parallel_state_construction = elapsed_since(start);
+
+        auto produces_lexeme = std::vector<bool>(states.size());
+        for (StateIndex i = 0; i < states.size(); ++i)
+            produces_lexeme[i] = states[i].transitions[START].produces_lexeme;
+
+        start = Clock::now();
+        this->minimize(produces_lexeme);
+        this->timings.parallel_state_minimization = elapsed_since(start);
+    }
+
+    void ParallelLexer::minimize(const std::vector<bool>& produces_lexeme) {
+        // The lexer only observes the lexeme and produces_lexeme flag of the transition from the start state
+        // of a parallel state, and parallel states are only ever combined through the merge table. Two states
+        // are equivalent if they are observably equal, and merging them with any state, from either side,
+        // again yields equivalent states. This is computed using Moore's partition refinement, where every
+        // state acts as symbol twice: once as left operand and once as right operand.
+        size_t n = this->merge_table.states();
+
+        auto block = std::vector<StateIndex>(n);
+        size_t num_blocks = 0;
         {
-            auto identity = ParallelState(dfa.num_states());
-            for (size_t i = 0; i < identity.transitions.size(); ++i) {
-                identity.transitions[i].result_state = i;
+            auto observations = std::map<std::pair<const Lexeme*, bool>, StateIndex>();
+            for (StateIndex i = 0; i < n; ++i) {
+                auto key = std::make_pair(this->final_states[i], bool(produces_lexeme[i]));
+                block[i] = observations.insert({key, observations.size()}).first->second;
             }
-            this->identity_state_index = enqueue(std::move(identity));
+            num_blocks = observations.size();
         }
 
-        auto merge = [&](StateIndex i, StateIndex j) {
-            StateIndex result;
-            // We need to handle the identity stage separately here, as we
-            // normally just copy the produces_lexeme property from the right hand site,
-            // but if the right hand site is the identity state thats not correct.
-            if (i == this->identity_state_index) {
-                result = j;
-            } else if (j == this->identity_state_index) {
-                result = i;
-            } else {
-                auto ps = states[i];
-                ps.merge(states[j]);
-                result = enqueue(std::move(ps));
+        while (true) {
+            // Comparing full signatures of 2n + 1 elements for every pair of states is expensive, so states are
+            // first grouped by the hash of their signature, and only compared to the representatives of the
+            // blocks with the same hash.
+            auto signature_hash = [&](StateIndex i) {
+                size_t hash = block[i];
+                for (StateIndex j = 0; j < n; ++j) {
+                    hash = hash_combine(hash, block[this->merge_table(i, j).result_state]);
+                    hash = hash_combine(hash, block[this->merge_table(j, i).result_state]);
+                }
+                return hash;
+            };
+
+            auto equivalent = [&](StateIndex a, StateIndex b) {
+                if (block[a] != block[b])
+                    return false;
+
+                for (StateIndex j = 0; j < n; ++j) {
+                    if (block[this->merge_table(a, j).result_state] != block[this->merge_table(b, j).result_state])
+                        return false;
+                    if (block[this->merge_table(j, a).result_state] != block[this->merge_table(j, b).result_state])
+                        return false;
+                }
+
+                return true;
+            };
+
+            auto representatives = std::unordered_map<size_t, std::vector<StateIndex>>();
+            auto new_block = std::vector<StateIndex>(n);
+            size_t num_new_blocks = 0;
+
+            for (StateIndex i = 0; i < n; ++i) {
+                auto& candidates = representatives[signature_hash(i)];
+                auto it = std::find_if(candidates.begin(), candidates.end(), [&](StateIndex rep) {
+                    return equivalent(i, rep);
+                });
+
+                if (it == candidates.end()) {
+                    candidates.push_back(i);
+                    new_block[i] = num_new_blocks++;
+                } else {
+                    new_block[i] = new_block[*it];
+                }
             }
 
-            bool produces_lexeme = states[result].transitions[START].produces_lexeme;
-            this->merge_table(i, j) = {result, produces_lexeme};
+            bool stable = num_new_blocks == num_blocks;
+            block = std::move(new_block);
+            num_blocks = num_new_blocks;
+
+            if (stable)
+                break;
+        }
+
+        if (num_blocks == n)
+            return;
+
+        // Blocks are numbered in order of their first state, so use the first state of each block as its representative.
+        auto representatives = std::vector<StateIndex>(num_blocks);
+        for (StateIndex i = n; i-- > 0;)
+            representatives[block[i]] = i;
+
+        auto map = [&](const Transition& t) {
+            return Transition(block[t.result_state], t.produces_lexeme);
         };
 
-        // Repeatedly perform the merges until no new merge is added
-        for (StateIndex i = 0; i < states.size(); ++i) {
-            auto first = states[i];
-            for (StateIndex j = 0; j < states.size(); ++j) {
-                merge(i, j);
-                merge(j, i);
+        for (auto& t : this->initial_states)
+            t = map(t);
+
+        auto merge_table = MergeTable();
+        merge_table.resize(num_blocks);
+        for (StateIndex i = 0; i < num_blocks; ++i) {
+            for (StateIndex j = 0; j < num_blocks; ++j) {
+                merge_table(i, j) = map(this->merge_table(representatives[i], representatives[j]));
             }
         }
+        this->merge_table = std::move(merge_table);
 
-        // Compute the final state mapping
-        this->final_states.resize(seen.size(), nullptr);
-        for (const auto& [ps, i] : seen) {
-            this->final_states[i] = dfa[ps.transitions[START].result_state].lexeme;
+        auto final_states = std::vector<const Lexeme*>(num_blocks);
+        for (StateIndex i = 0; i < num_blocks; ++i)
+            final_states[i] = this->final_states[representatives[i]];
+        this->final_states = std::move(final_states);
+
+        this->identity_state_index = block[this->identity_state_index];
+    }
+
+    auto ParallelLexer::initial_state(uint8_t byte) const -> const Transition& {
+        return this->initial_states[this->byte_classes[byte]];
+    }
+
+    size_t ParallelLexer::state_bits() const {
+        size_t states = std::max(this->merge_table.states(), this->dfa_final_states.size());
+        // One bit extra for the produces-lexeme flag.
+        size_t bits = std::bit_width(states - 1) + 1;
+        for (size_t width : {8, 16, 32}) {
+            if (bits <= width)
+                return width;
         }
+
+        throw std::length_error("Too many lexer states");
     }
 
     void ParallelLexer::dump_sizes(std::ostream& out) const {
-        fmt::print(out, "Initial states table: {} element\n", this->initial_states.size());
-        fmt::print(out, "Merge table: {}² elements = {} elements\n", this->merge_table.states(), this->merge_table.states() * this->merge_table.states());
+        fmt::print(out, "Byte classes: {}\n", this->byte_classes.size());
+        fmt::print(out, "DFA states: {} ({} before minimization)\n", this->dfa_states, this->unminimized_dfa_states);
+        fmt::print(out, "Parallel states: {} ({} before minimization)\n", this->merge_table.states(), this->unminimized_states);
+        fmt::print(out, "State width: {} bits\n", this->state_bits());
+        fmt::print(out, "Byte class table: {} elements\n", ByteClasses::NUM_BYTES);
+        fmt::print(out, "Initial states table: {} elements\n", this->initial_states.size());
+        fmt::print(
+            out,
+            "Merge table: {}² elements = {} elements ({} bytes)\n",
+            this->merge_table.states(),
+            this->merge_table.states() * this->merge_table.states(),
+            this->merge_table.states() * this->merge_table.states() * this->state_bits() / 8
+        );
         fmt::print(out, "Final states table: {} elements\n", this->final_states.size());
+        fmt::print(out, "DFA transition table: {} elements\n", this->dfa_transitions.size());
+        fmt::print(out, "DFA final states table: {} elements\n", this->dfa_final_states.size());
+    }
+
+    void ParallelLexer::dump_timings(std::ostream& out) const {
+        fmt::print(out, "DFA construction: {}\n", this->timings.dfa_construction);
+        fmt::print(out, "DFA minimization: {}\n", this->timings.dfa_minimization);
+        fmt::print(out, "Parallel state construction: {}\n", this->timings.parallel_state_construction);
+        fmt::print(out, "Parallel state minimization: {}\n", this->timings.parallel_state_minimization);
     }
 };
@@ -4,7 +4,6 @@
 #include <fmt/ostream.h>
 #include <iostream>
 
-#include <bitset>
 #include <limits>
 #include <cassert>
 
@@ -21,10 +20,10 @@ namespace pareas::lexer {
         }
     }
 
-    auto SequenceNode::compile(FiniteStateAutomaton& fsa, StateIndex start) const -> StateIndex {
+    auto SequenceNode::compile(FiniteStateAutomaton& fsa, StateIndex start, const ByteClasses& classes) const -> StateIndex {
         StateIndex end = start;
         for (const auto& child : this->children) {
-            end = child->compile(fsa, end);
+            end = child->compile(fsa, end, classes);
         }
         return end;
     }
@@ -38,6 +37,12 @@ namespace pareas::lexer {
         return true;
     }
 
+    void SequenceNode::refine_byte_classes(ByteClasses& classes) const {
+        for (const auto& child : this->children) {
+            child->refine_byte_classes(classes);
+        }
+    }
+
     void AlternationNode::print(std::ostream& os) const {
         if (this->children.size() == 1) {
             this->children[0]->print(os);
@@ -56,14 +61,14 @@ namespace pareas::lexer {
         }
     }
 
-    auto AlternationNode::compile(FiniteStateAutomaton& fsa, StateIndex start) const -> StateIndex {
+    auto AlternationNode::compile(FiniteStateAutomaton& fsa, StateIndex start, const ByteClasses& classes) const -> StateIndex {
         if (this->children.empty())
             return start;
 
         auto end = fsa.add_state();
         for (const auto& child : this->children) {
             auto child_start = fsa.add_state();
-            auto child_end = child->compile(fsa, child_start);
+            auto child_end = child->compile(fsa, child_start, classes);
             fsa.add_epsilon_transition(start, child_start);
             fsa.add_epsilon_transition(child_end, end);
         }
@@ -80,6 +85,12 @@ namespace pareas::lexer {
         return this->children.size() == 0;
     }
 
+    void AlternationNode::refine_byte_classes(ByteClasses& classes) const {
+        for (const auto& child : this->children) {
+            child->refine_byte_classes(classes);
+        }
+    }
+
     void RepeatNode::print(std::ostream& os) const {
         this->child->print(os);
 
@@ -98,9 +109,9 @@ namespace pareas::lexer {
         fmt::print(os, "{}", c);
     }
 
-    auto RepeatNode::compile(FiniteStateAutomaton& fsa, StateIndex start) const -> StateIndex {
+    auto RepeatNode::compile(FiniteStateAutomaton& fsa, StateIndex start, const ByteClasses& classes) const -> StateIndex {
         auto loop_start = fsa.add_state();
-        auto loop_end = this->child->compile(fsa, loop_start);
+        auto loop_end = this->child->compile(fsa, loop_start, classes);
         auto end = fsa.add_state();
 
         fsa.add_epsilon_transition(start, loop_start);
@@ -127,6 +138,10 @@ namespace pareas::lexer {
         }
     }
 
+    void RepeatNode::refine_byte_classes(ByteClasses& classes) const {
+        this->child->refine_byte_classes(classes);
+    }
+
     void CharSetNode::print(std::ostream& os) const {
         fmt::print(os, "[{}", this->inverted ? "^" : "");
 
@@ -140,35 +155,29 @@ namespace pareas::lexer {
         fmt::print(os, "]");
     }
 
-    auto CharSetNode::compile(FiniteStateAutomaton& fsa, StateIndex start) const -> StateIndex {
+    auto CharSetNode::compile(FiniteStateAutomaton& fsa, StateIndex start, const ByteClasses& classes) const -> StateIndex {
         auto end = fsa.add_state();
 
-        if (this->inverted) {
-            auto bits = std::bitset<FiniteStateAutomaton::MAX_SYM + 1>();
-
-            for (const auto [min, max] : this->ranges) {
-                for (int c = min; c <= max; ++c) {
-                    bits.set(c);
-                }
-            }
-
-            for (size_t c = 0; c < bits.size(); ++c) {
-                if (!bits.test(c))
-                    fsa.add_transition(start, end, c);
-            }
-        } else {
-            for (const auto [min, max] : this->ranges) {
-                for (int c = min; c <= max; ++c) {
-                    fsa.add_transition(start, end, c);
-                }
-            }
+        // The bytes of this set are a union of byte classes, so a transition is added for each of them.
+        auto class_set = classes.classes_of(this->bytes());
+        for (size_t c = 0; c < classes.size(); ++c) {
+            if (class_set.test(c))
+                fsa.add_transition(start, end, c);
         }
 
         return end;
     }
 
     bool CharSetNode::matches_empty() const {
-        auto bits = std::bitset<FiniteStateAutomaton::MAX_SYM + 1>();
+        return this->bytes().none();
+    }
+
+    void CharSetNode::refine_byte_classes(ByteClasses& classes) const {
+        classes.refine(this->bytes());
+    }
+
+    auto CharSetNode::bytes() const -> ByteClasses::ByteSet {
+        auto bits = ByteClasses::ByteSet();
 
         for (const auto [min, max] : this->ranges) {
             for (int c = min; c <= max; ++c) {
@@ -179,16 +188,16 @@ namespace pareas::lexer {
         if (this->inverted)
             bits.flip();
 
-        return bits.none();
+        return bits;
     }
 
     void CharNode::print(std::ostream& os) const {
         fmt::print(os, "{:r}", EscapeFormatter{this->c});
     }
 
-    auto CharNode::compile(FiniteStateAutomaton& fsa, StateIndex start) const -> StateIndex {
+    auto CharNode::compile(FiniteStateAutomaton& fsa, StateIndex start, const ByteClasses& classes) const -> StateIndex {
         auto end = fsa.add_state();
-        fsa.add_transition(start, end, this->c);
+        fsa.add_transition(start, end, classes[this->c]);
         return end;
     }
 
@@ -196,13 +205,21 @@ namespace pareas::lexer {
         return false;
     }
 
+    void CharNode::refine_byte_classes(ByteClasses& classes) const {
+        auto bits = ByteClasses::ByteSet();
+        bits.set(this->c);
+        classes.refine(bits);
+    }
+
     void EmptyNode::print(std::ostream& is) const {}
 
-    auto EmptyNode::compile(FiniteStateAutomaton& fsa, StateIndex start) const -> StateIndex {
+    auto EmptyNode::compile(FiniteStateAutomaton& fsa, StateIndex start, const ByteClasses& classes) const -> StateIndex {
         return start;
     }
 
     bool EmptyNode::matches_empty() const {
         return true;
     }
+
+    void EmptyNode::refine_byte_classes(ByteClasses& classes) const {}
 }
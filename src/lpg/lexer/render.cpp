@@ -1,100 +1,141 @@
 #include "pareas/lpg/lexer/render.hpp"
 
 #include <fmt/ostream.h>
+#include <fmt/format.h>
 
+#include <vector>
+#include <algorithm>
 #include <cassert>
 
 namespace pareas::lexer {
     LexerRenderer::LexerRenderer(Renderer* r, const TokenMapping* tm, const ParallelLexer* lexer):
-        r(r), tm(tm), lexer(lexer) {
+        r(r), tm(tm), lexer(lexer), state_bits(lexer->state_bits()) {
     }
 
     void LexerRenderer::render() const {
         assert(this->lexer->merge_table.states() == this->lexer->final_states.size());
 
-        fmt::print(this->r->fut, "let identity_state: u{} = {}\n", ENCODED_TRANSITION_BITS, this->lexer->identity_state_index);
+        fmt::print(this->r->fut, "module lex_state = u{}\n", this->state_bits);
+        fmt::print(this->r->fut, "let identity_state: lex_state.t = {}\n", this->lexer->identity_state_index);
 
         fmt::print(
             this->r->hpp,
             "struct LexTable {{\n"
-            "    using State = uint16_t;\n"
-            "    static constexpr const size_t NUM_INITIAL_STATES = 256;\n"
+            "    using State = uint{}_t;\n"
+            "    using ByteClass = uint8_t;\n"
+            "    static constexpr const size_t NUM_BYTES = 256;\n"
+            "    static constexpr const State PRODUCES_TOKEN_MASK = {:#x};\n"
             "    size_t n;\n"
-            "    const State* initial_states; // NUM_INITIAL_STATES\n"
-            "    const State* merge_table; // n * n\n"
+            "    size_t num_byte_classes;\n"
+            "    const ByteClass* byte_classes; // NUM_BYTES\n"
+            "    const State* initial_states; // num_byte_classes\n"
+            "    const State* merge_table; // n * n, followed by padding up to a 32-bit word\n"
             "    const Token* final_states; // n\n"
-            "}};\n"
-            "extern const LexTable lex_table;\n"
+            "    State identity_state;\n"
+            "    size_t num_dfa_states;\n"
+            "    const State* dfa_transitions; // num_dfa_states * num_byte_classes\n"
+            "    const Token* dfa_final_states; // num_dfa_states\n"
+            "    State dfa_start_state;\n"
+            "}};\n",
+            this->state_bits,
+            this->produces_lexeme_mask()
         );
 
-        auto initial_state_offset = this->render_initial_state_data();
-        auto merge_table_offset = this->render_merge_table_data();
-        auto final_state_offset = this->render_final_state_data();
-
-        fmt::print(
-            this->r->cpp,
-            "const LexTable lex_table = {{\n"
-            "    .n = {},\n"
-            "    .initial_states = {},\n"
-            "    .merge_table = {},\n"
-            "    .final_states = {}\n"
-            "}};\n",
-            this->lexer->merge_table.states(),
-            this->r->render_offset_cast(initial_state_offset, "LexTable::State"),
-            this->r->render_offset_cast(merge_table_offset, "LexTable::State"),
-            this->r->render_offset_cast(final_state_offset, "Token")
+        auto byte_classes = this->render_byte_class_data();
+        auto initial_states = this->render_transition_data("lex_table_initial_states", this->lexer->initial_states);
+        auto merge_table = this->render_merge_table_data();
+        auto final_states = this->render_final_state_data("lex_table_final_states", this->lexer->final_states);
+        auto dfa_transitions = this->render_transition_data("lex_table_dfa_transitions", this->lexer->dfa_transitions);
+        auto dfa_final_states = this->render_final_state_data("lex_table_dfa_final_states", this->lexer->dfa_final_states);
+
+        this->r->render_definition(
+            "const LexTable",
+            "lex_table",
+            fmt::format(
+                "{{\n"
+                "    .n = {},\n"
+                "    .num_byte_classes = {},\n"
+                "    .byte_classes = {},\n"
+                "    .initial_states = {},\n"
+                "    .merge_table = {},\n"
+                "    .final_states = {},\n"
+                "    .identity_state = {},\n"
+                "    .num_dfa_states = {},\n"
+                "    .dfa_transitions = {},\n"
+                "    .dfa_final_states = {},\n"
+                "    .dfa_start_state = {}\n"
+                "}}",
+                this->lexer->merge_table.states(),
+                this->lexer->byte_classes.size(),
+                byte_classes,
+                initial_states,
+                merge_table,
+                final_states,
+                this->lexer->identity_state_index,
+                this->lexer->dfa_final_states.size(),
+                dfa_transitions,
+                dfa_final_states,
+                ParallelLexer::START
+            )
         );
     }
 
-    size_t LexerRenderer::render_initial_state_data() const {
-        this->r->align_data(sizeof(EncodedTransition));
-        auto offset = this->r->data_offset();
-
-        uint64_t dim = this->lexer->initial_states.size();
-        for (uint64_t i = 0; i < dim; ++i) {
-            const auto& transition = this->lexer->initial_states[i];
-            auto encoded = this->encode(transition);
-            this->r->write_data_int(encoded, sizeof(EncodedTransition));
+    std::string LexerRenderer::render_byte_class_data() const {
+        auto values = std::vector<uint64_t>();
+        for (size_t byte = 0; byte < ByteClasses::NUM_BYTES; ++byte) {
+            values.push_back(this->lexer->byte_classes[byte]);
         }
 
-        return offset;
+        return this->r->render_array("lex_table_byte_classes", "LexTable::ByteClass", sizeof(ByteClasses::ClassIndex), values);
     }
 
-    size_t LexerRenderer::render_merge_table_data() const {
-        this->r->align_data(sizeof(EncodedTransition));
-        auto offset = this->r->data_offset();
+    std::string LexerRenderer::render_transition_data(std::string_view name, std::span<const ParallelLexer::Transition> transitions) const {
+        auto values = std::vector<uint64_t>();
+        for (const auto& transition : transitions) {
+            values.push_back(this->encode(transition));
+        }
+
+        return this->r->render_array(name, "LexTable::State", this->state_bits / 8, values);
+    }
 
+    std::string LexerRenderer::render_merge_table_data() const {
         const auto& merge_table = this->lexer->merge_table;
 
         uint64_t dim = merge_table.states();
+        auto values = std::vector<uint64_t>();
+        values.reserve(dim * dim + 4);
+
         // Make sure to iterate in right order
         for (uint64_t x = 0; x < dim; ++x) {
             for (uint64_t y = 0; y < dim; ++y) {
-                auto encoded = this->encode(merge_table(x, y));
-                this->r->write_data_int(encoded, sizeof(EncodedTransition));
+                values.push_back(this->encode(merge_table(x, y)));
             }
         }
 
-        return offset;
-    }
-
-    size_t LexerRenderer::render_final_state_data() const {
-        this->r->align_data(this->tm->backing_type_bits() / 8);
-        auto offset = this->r->data_offset();
+        // Lexers on the host may gather elements of the merge table as the low part of a 32-bit word,
+        // so pad it to make sure that the last element can be loaded like that as well.
+        size_t padding = std::max<size_t>(1, 32 / this->state_bits - 1);
+        values.insert(values.end(), padding, 0);
 
-        uint64_t dim = this->lexer->final_states.size();
-        for (uint64_t i = 0; i < dim; ++i) {
-            const auto* lexeme = this->lexer->final_states[i];
+        return this->r->render_array("lex_table_merge_table", "LexTable::State", this->state_bits / 8, values);
+    }
 
+    std::string LexerRenderer::render_final_state_data(std::string_view name, std::span<const Lexeme* const> final_states) const {
+        auto values = std::vector<uint64_t>();
+        for (const auto* lexeme : final_states) {
             uint64_t token_definition = lexeme ? this->tm->token_id(lexeme->as_token()) : this->tm->token_id(Token::INVALID);
-            this->r->write_data_int(token_definition, this->tm->backing_type_bits() / 8);
+            values.push_back(token_definition);
         }
 
-        return offset;
+        return this->r->render_array(name, "Token", this->tm->backing_type_bits() / 8, values, Renderer::Element::SCOPED_ENUM);
+    }
+
+    uint64_t LexerRenderer::produces_lexeme_mask() const {
+        return uint64_t{1} << (this->state_bits - 1);
     }
 
-    auto LexerRenderer::encode(const ParallelLexer::Transition& t) const -> EncodedTransition {
-        assert(t.result_state < PRODUCES_TOKEN_MASK);
-        return t.result_state | (t.produces_lexeme ? PRODUCES_TOKEN_MASK : 0);
+    uint64_t LexerRenderer::encode(const ParallelLexer::Transition& t) const {
+        assert(t.result_state < this->produces_lexeme_mask());
+        return t.result_state | (t.produces_lexeme ? this->produces_lexeme_mask() : 0);
     }
 }
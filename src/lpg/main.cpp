@@ -3,6 +3,7 @@
 #include "pareas/lpg/cli_util.hpp"
 #include "pareas/lpg/token_mapping.hpp"
 #include "pareas/lpg/renderer.hpp"
+#include "pareas/lpg/output_cache.hpp"
 #include "pareas/lpg/parser/grammar.hpp"
 #include "pareas/lpg/parser/grammar_parser.hpp"
 #include "pareas/lpg/parser/terminal_set_functions.hpp"
@@ -23,7 +24,10 @@
 #include <iterator>
 #include <stdexcept>
 #include <optional>
+#include <filesystem>
+#include <charconv>
 #include <cstdlib>
+#include <cstring>
 #include <cassert>
 
 namespace {
@@ -34,7 +38,10 @@ namespace {
         const char* lexer_src;
         const char* output;
         const char* namesp;
+        const char* cache_dir;
+        Emit emit;
         bool check;
+        unsigned threads;
         bool verbose_lexer;
         bool verbose_grammar;
         bool verbose_sets;
@@ -54,12 +61,32 @@ namespace {
             "-o --output <path>          Basename of generated output files.\n"
             "--namespace <namespace>     Emit c++ definitions under <namespace>\n"
             "--check                     Don't write output.\n"
-            "--verbose-lexer             Dump sizes of lexer tables.\n"
+            "--emit <incbin|constexpr>   Select how table data is embedded in the\n"
+            "                            generated C++ code. 'incbin' (default) writes\n"
+            "                            it to a .dat file, included by a .S file using\n"
+            "                            the assembler. 'constexpr' renders the tables\n"
+            "                            as constexpr arrays in the header instead, so\n"
+            "                            that lookups can be constant folded and inlined.\n"
+            "                            Note that large tables may take the C++\n"
+            "                            compiler a long time to process.\n"
+            "--cache-dir <path>          Cache generated output files in <path>, keyed by\n"
+            "                            a hash of the inputs, namespace and generator\n"
+            "                            version. When an entry exists, the output files\n"
+            "                            are copied from the cache instead, and none of\n"
+            "                            the --verbose options have any effect.\n"
+            "-t --threads <amount>       Set the maximum number of threads used to\n"
+            "                            generate the lexer. Defaults to the number of\n"
+            "                            cores.\n"
+            "--verbose-lexer             Dump sizes of lexer tables, the number of states\n"
+            "                            before and after minimization, and the time\n"
+            "                            spent in every phase of lexer generation.\n"
             "--verbose-grammar           Dump parsed grammar to stderr.\n"
             "--verbose-sets              Dump first/last/follow/before sets to stderr.\n"
             "--verbose-psls              Dump PSLS as CSV to stderr.\n"
             "--verbose-ll                Dump LL table as CSV to stderr.\n"
-            "--verbose-llp               Dump LLP table as CSV to stderr.\n"
+            "--verbose-llp               Dump LLP table as CSV to stderr, the number of\n"
+            "                            LLP items and the time spent constructing them,\n"
+            "                            and the sizes of the rendered parser tables.\n"
             "-h --help                   Show this message and exit.\n"
             "\n"
             "Either or both of --parser and --lexer are required, as well as\n"
@@ -74,7 +101,10 @@ namespace {
             .lexer_src = nullptr,
             .output = nullptr,
             .namesp = nullptr,
+            .cache_dir = nullptr,
+            .emit = Emit::INCBIN,
             .check = false,
+            .threads = 0,
             .verbose_lexer = false,
             .verbose_grammar = false,
             .verbose_sets = false,
@@ -84,6 +114,9 @@ namespace {
             .help = false,
         };
 
+        const char* threads_arg = nullptr;
+        const char* emit_arg = nullptr;
+
         for (int i = 1; i < argc; ++i) {
             auto arg = std::string_view(argv[i]);
 
@@ -102,8 +135,17 @@ namespace {
             } else if (arg == "--namespace") {
                 ptr = &opts.namesp;
                 argname = "namespace";
+            } else if (arg == "--cache-dir") {
+                ptr = &opts.cache_dir;
+                argname = "path";
+            } else if (arg == "--emit") {
+                ptr = &emit_arg;
+                argname = "incbin|constexpr";
             } else if (arg == "--check") {
                 opts.check = true;
+            } else if (arg == "-t" || arg == "--threads") {
+                ptr = &threads_arg;
+                argname = "amount";
             } else if (arg == "--verbose-lexer") {
                 opts.verbose_lexer = true;
             } else if (arg == "--verbose-grammar") {
@@ -136,6 +178,27 @@ namespace {
         if (opts.help)
             return true;
 
+        if (threads_arg) {
+            const auto* end = threads_arg + std::strlen(threads_arg);
+            auto [p, ec] = std::from_chars(threads_arg, end, opts.threads);
+            if (ec != std::errc() || p != end || opts.threads < 1) {
+                fmt::print(std::cerr, "Error: Invalid value '{}' for option --threads\n", threads_arg);
+                return false;
+            }
+        }
+
+        if (emit_arg) {
+            auto emit = std::string_view(emit_arg);
+            if (emit == "incbin") {
+                opts.emit = Emit::INCBIN;
+            } else if (emit == "constexpr") {
+                opts.emit = Emit::CONSTEXPR;
+            } else {
+                fmt::print(std::cerr, "Error: Invalid value '{}' for option --emit\n", emit_arg);
+                return false;
+            }
+        }
+
         if (!opts.parser_src && !opts.lexer_src) {
             fmt::print(std::cerr, "Error: Missing either or both of --parser or --lexer\n");
             return false;
@@ -164,19 +227,22 @@ namespace {
         return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
     }
 
+    bool read_inputs(const Options& opts, std::optional<std::string>& lexer_input, std::optional<std::string>& parser_input) {
+        if (opts.lexer_src && !(lexer_input = read_input(opts.lexer_src)))
+            return false;
+
+        if (opts.parser_src && !(parser_input = read_input(opts.parser_src)))
+            return false;
+
+        return true;
+    }
+
     struct LexerGeneration {
         lexer::LexicalGrammar grammar;
         lexer::ParallelLexer parallel_lexer;
     };
 
-    std::optional<LexerGeneration> generate_lexer(const Options& opts, TokenMapping& tm) {
-        std::string input;
-        if (auto maybe_input = read_input(opts.lexer_src)) {
-            input = std::move(maybe_input.value());
-        } else {
-            return std::nullopt;
-        }
-
+    std::optional<LexerGeneration> generate_lexer(const Options& opts, std::string_view input, TokenMapping& tm) {
         try {
             auto er = ErrorReporter(input, std::clog);
             auto parser = Parser(&er, input);
@@ -185,10 +251,11 @@ namespace {
             auto g = lexer_parser.parse();
             g.validate(er);
 
-            auto parallel_lexer = lexer::ParallelLexer(&g);
+            auto parallel_lexer = lexer::ParallelLexer(&g, opts.threads);
 
             if (opts.verbose_lexer) {
                 parallel_lexer.dump_sizes(std::cout);
+                parallel_lexer.dump_timings(std::cout);
             }
 
             g.add_tokens(tm);
@@ -205,14 +272,7 @@ namespace {
         parser::llp::ParsingTable llp_table;
     };
 
-    std::optional<ParserGeneration> generate_parser(const Options& opts, TokenMapping& tm, bool derive_tokens) {
-        std::string input;
-        if (auto maybe_input = read_input(opts.parser_src)) {
-            input = std::move(maybe_input.value());
-        } else {
-            return std::nullopt;
-        }
-
+    std::optional<ParserGeneration> generate_parser(const Options& opts, std::string_view input, TokenMapping& tm, bool derive_tokens) {
         try {
             auto er = ErrorReporter(input, std::clog);
             auto parser = Parser(&er, input);
@@ -231,6 +291,8 @@ namespace {
             auto psls_table = gen.build_psls_table();
             if (opts.verbose_psls)
                 psls_table.dump_csv(std::clog);
+            if (opts.verbose_llp)
+                gen.dump_sizes(std::clog);
 
             auto ll_table = parser::ll::Generator(&er, &g, &tsf).build_parsing_table();
             if (opts.verbose_ll)
@@ -257,6 +319,20 @@ namespace {
             return std::nullopt;
         }
     }
+
+    uint64_t compute_cache_key(const Options& opts, const std::optional<std::string>& lexer_input, const std::optional<std::string>& parser_input) {
+        // The output basename is part of the key, as the generated sources refer to each other by it.
+        auto hasher = Fnv1a();
+        hasher.update_field(OutputCache::GENERATOR_VERSION);
+        hasher.update_field(opts.namesp);
+        hasher.update_field(opts.emit == Emit::INCBIN ? "incbin" : "constexpr");
+        hasher.update_field(std::filesystem::path(opts.output).filename().native());
+        hasher.update_field(lexer_input.has_value() ? "lexer" : "");
+        hasher.update_field(lexer_input.value_or(""));
+        hasher.update_field(parser_input.has_value() ? "parser" : "");
+        hasher.update_field(parser_input.value_or(""));
+        return hasher.digest();
+    }
 }
 
 int main(int argc, char* argv[]) {
@@ -268,10 +344,28 @@ int main(int argc, char* argv[]) {
         print_usage(argv[0]);
     }
 
+    std::optional<std::string> lexer_input;
+    std::optional<std::string> parser_input;
+    if (!read_inputs(opts, lexer_input, parser_input))
+        return EXIT_FAILURE;
+
+    auto cache = std::optional<OutputCache>();
+    if (opts.cache_dir && !opts.check) {
+        cache.emplace(opts.cache_dir, compute_cache_key(opts, lexer_input, parser_input));
+
+        // Failing to use the cache is not fatal, the output is simply generated instead.
+        try {
+            if (cache->restore(opts.output))
+                return EXIT_SUCCESS;
+        } catch (const std::filesystem::filesystem_error& e) {
+            fmt::print(std::cerr, "Warning: Failed to restore output from cache: {}\n", e.what());
+        }
+    }
+
     auto tm = TokenMapping();
 
-    auto lexer = opts.lexer_src ? generate_lexer(opts, tm) : std::nullopt;
-    auto parser = opts.parser_src ? generate_parser(opts, tm, !lexer.has_value()) : std::nullopt;
+    auto lexer = lexer_input ? generate_lexer(opts, lexer_input.value(), tm) : std::nullopt;
+    auto parser = parser_input ? generate_parser(opts, parser_input.value(), tm, !lexer.has_value()) : std::nullopt;
 
     // Only do this check here so we can report errors for both parser and lexer construction.
     if ((opts.lexer_src && !lexer.has_value()) || (opts.parser_src && !parser.has_value()))
@@ -281,7 +375,7 @@ int main(int argc, char* argv[]) {
         return EXIT_SUCCESS;
 
     try {
-        auto renderer = pareas::Renderer(opts.namesp, opts.output);
+        auto renderer = pareas::Renderer(opts.namesp, opts.output, opts.emit);
 
         tm.render(renderer);
 
@@ -293,11 +387,23 @@ int main(int argc, char* argv[]) {
         if (parser.has_value()) {
             auto pr = pareas::parser::llp::ParserRenderer(&renderer, &tm, &parser->grammar, &parser->llp_table);
             pr.render();
+
+            if (opts.verbose_llp)
+                pr.dump_sizes(std::clog);
         }
 
         renderer.finalize();
     } catch (const RenderError& e) {
         fmt::print("Error: {}\n", e.what());
+        return EXIT_SUCCESS;
+    }
+
+    if (cache.has_value()) {
+        try {
+            cache->store(opts.output);
+        } catch (const std::filesystem::filesystem_error& e) {
+            fmt::print(std::cerr, "Warning: Failed to store output in cache: {}\n", e.what());
+        }
     }
 
     return EXIT_SUCCESS;
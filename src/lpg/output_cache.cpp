@@ -0,0 +1,99 @@
+#include "pareas/lpg/output_cache.hpp"
+
+#include <fmt/format.h>
+
+#include <system_error>
+#include <string>
+#include <unistd.h>
+
+namespace {
+    std::filesystem::path with_extension(const std::filesystem::path& output, std::string_view ext) {
+        auto filename = output;
+        filename.replace_extension(ext);
+        return filename;
+    }
+}
+
+namespace pareas {
+    OutputCache::OutputCache(const std::filesystem::path& dir, uint64_t key):
+        dir(dir), key(key) {}
+
+    bool OutputCache::restore(const std::filesystem::path& output) const {
+        auto entry = this->entry();
+        if (!std::filesystem::is_directory(entry))
+            return false;
+
+        // Not every output mode writes every file, so only restore those that are present.
+        auto filename = output.filename();
+        for (auto ext : EXTENSIONS) {
+            auto cached = with_extension(entry / filename, ext);
+            if (!std::filesystem::exists(cached))
+                continue;
+
+            std::filesystem::copy_file(
+                cached,
+                with_extension(output, ext),
+                std::filesystem::copy_options::overwrite_existing
+            );
+        }
+
+        return true;
+    }
+
+    void OutputCache::store(const std::filesystem::path& output) const {
+        auto entry = this->entry();
+        if (std::filesystem::is_directory(entry))
+            return;
+
+        // Populate a private directory first and move it in place afterwards, so that other invocations
+        // never observe a partially written entry.
+        auto tmp = this->dir / fmt::format("{}.tmp-{}", entry.filename().native(), ::getpid());
+        std::filesystem::create_directories(tmp);
+
+        auto filename = output.filename();
+        for (auto ext : EXTENSIONS) {
+            auto generated = with_extension(output, ext);
+            if (!std::filesystem::exists(generated))
+                continue;
+
+            std::filesystem::copy_file(
+                generated,
+                with_extension(tmp / filename, ext),
+                std::filesystem::copy_options::overwrite_existing
+            );
+        }
+
+        auto ec = std::error_code();
+        std::filesystem::rename(tmp, entry, ec);
+        if (ec) {
+            // Another invocation stored the same entry in the meantime.
+            std::filesystem::remove_all(tmp);
+            if (!std::filesystem::is_directory(entry))
+                throw std::filesystem::filesystem_error("Failed to store cache entry", tmp, entry, ec);
+        }
+    }
+
+    std::filesystem::path OutputCache::entry() const {
+        return this->dir / fmt::format("{:016x}", this->key);
+    }
+
+    void Fnv1a::update(std::string_view data) {
+        for (unsigned char c : data) {
+            this->hash ^= c;
+            this->hash *= PRIME;
+        }
+    }
+
+    void Fnv1a::update_field(std::string_view data) {
+        auto size = static_cast<uint64_t>(data.size());
+        for (size_t i = 0; i < sizeof(size); ++i) {
+            char byte = static_cast<char>(size >> (i * 8));
+            this->update(std::string_view(&byte, 1));
+        }
+        this->update(data);
+    }
+
+    uint64_t Fnv1a::digest() const {
+        return this->hash;
+    }
+}
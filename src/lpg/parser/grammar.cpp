@@ -170,6 +170,53 @@ namespace pareas::parser {
             throw TokenLinkError();
     }
 
+    void Grammar::intern_symbols() {
+        this->terminals.clear();
+        this->non_terminals.clear();
+        this->terminal_ids.clear();
+        this->non_terminal_ids.clear();
+
+        auto add_terminal = [&](const Terminal& t) {
+            if (this->terminal_ids.insert({t, this->terminals.size()}).second)
+                this->terminals.push_back(t);
+        };
+
+        auto add_non_terminal = [&](const NonTerminal& nt) {
+            if (this->non_terminal_ids.insert({nt, this->non_terminals.size()}).second)
+                this->non_terminals.push_back(nt);
+        };
+
+        add_terminal(Terminal::EMPTY);
+        add_terminal(Terminal::START_OF_INPUT);
+        add_terminal(Terminal::END_OF_INPUT);
+
+        for (const auto& prod : this->productions) {
+            add_non_terminal(prod.lhs);
+            for (const auto& sym : prod.rhs) {
+                if (sym.is_terminal())
+                    add_terminal(sym.as_terminal());
+                else
+                    add_non_terminal(sym.as_non_terminal());
+            }
+        }
+
+        assert(this->terminal_ids.at(Terminal::EMPTY) == EMPTY_ID);
+        assert(this->terminal_ids.at(Terminal::START_OF_INPUT) == START_OF_INPUT_ID);
+        assert(this->terminal_ids.at(Terminal::END_OF_INPUT) == END_OF_INPUT_ID);
+    }
+
+    size_t Grammar::terminal_id(const Terminal& t) const {
+        return this->terminal_ids.at(t);
+    }
+
+    size_t Grammar::non_terminal_id(const NonTerminal& nt) const {
+        return this->non_terminal_ids.at(nt);
+    }
+
+    size_t Grammar::symbol_id(const Symbol& sym) const {
+        return sym.is_terminal() ? this->terminal_id(sym.as_terminal()) : this->non_terminal_id(sym.as_non_terminal());
+    }
+
     size_t Grammar::production_id(const Production* p) const {
         assert(p >= this->productions.data() && p < &this->productions.data()[this->productions.size()]);
         return p - this->productions.data();
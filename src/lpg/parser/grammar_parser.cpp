@@ -33,8 +33,15 @@ namespace pareas::parser {
         if (error)
             throw GrammarParseError();
 
-        auto g = Grammar{std::move(this->productions)};
+        auto g = Grammar{
+            .productions = std::move(this->productions),
+            .terminals = {},
+            .non_terminals = {},
+            .terminal_ids = {},
+            .non_terminal_ids = {},
+        };
         g.validate(*this->parser->er);
+        g.intern_symbols();
         return g;
     }
 
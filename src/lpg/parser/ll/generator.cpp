@@ -25,19 +25,19 @@ namespace pareas::parser::ll {
             auto first = this->tsf->compute_first(prod.rhs);
 
             bool has_empty = false;
-            for (const auto& t : first) {
-                if (t.is_empty()) {
+            for (auto t : first) {
+                if (t == Grammar::EMPTY_ID) {
                     has_empty = true;
                     continue;
                 }
 
-                insert({prod.lhs, t}, &prod);
+                insert({prod.lhs, this->g->terminals[t]}, &prod);
             }
 
             if (has_empty) {
                 const auto& follow = this->tsf->follow(prod.lhs);
-                for (const auto& t : follow) {
-                    insert({prod.lhs, t}, &prod);
+                for (auto t : follow) {
+                    insert({prod.lhs, this->g->terminals[t]}, &prod);
                 }
             }
         }
@@ -1,15 +1,33 @@
 #include "pareas/lpg/parser/llp/generator.hpp"
 
 #include <fmt/ostream.h>
+#include <fmt/chrono.h>
 
 #include <iostream>
 #include <deque>
+#include <unordered_set>
 #include <algorithm>
 #include <cassert>
 
 namespace pareas::parser::llp {
     Generator::Generator(ErrorReporter* er, const Grammar* g, const TerminalSetFunctions* tsf):
-        er(er), g(g), tsf(tsf) {}
+        er(er), g(g), tsf(tsf), items(g), productions_by_lhs(g->non_terminals.size()), item_set_time(0) {
+        for (const auto& prod : this->g->productions) {
+            this->productions_by_lhs[this->g->non_terminal_id(prod.lhs)].push_back(&prod);
+
+            auto& codes = this->rhs_codes.emplace_back();
+            for (const auto& sym : prod.rhs)
+                codes.push_back(this->items.symbol_code(sym));
+
+            auto us = this->tsf->last_of_prefix(&prod, prod.rhs.size());
+            if (us.contains(Grammar::EMPTY_ID)) {
+                us.erase(Grammar::EMPTY_ID);
+                merge_terminal_sets_omit_empty(us, this->tsf->before(prod.lhs));
+            }
+
+            this->closure_lookbacks.push_back(std::move(us));
+        }
+    }
 
     PSLSTable Generator::build_psls_table() {
         this->compute_item_sets();
@@ -18,16 +36,18 @@ namespace pareas::parser::llp {
         bool error = false;
 
         auto insert = [&](const Item& item) {
-            auto ap = AdmissiblePair{item.lookback, item.lookahead};
+            auto ap = AdmissiblePair{this->g->terminals[item.lookback], this->g->terminals[item.lookahead]};
             auto it = psls.table.find(ap);
 
+            auto item_gamma = this->items.gamma(item.gamma);
+
             if (it == psls.table.end()) {
-                psls.table.insert(it, {ap, {item.gamma, item.prod}});
+                psls.table.insert(it, {ap, {{item_gamma.begin(), item_gamma.end()}, item.prod}});
                 return;
             }
 
             const auto& gamma = it->second.gamma;
-            if (std::equal(gamma.begin(), gamma.end(), item.gamma.begin(), item.gamma.end()))
+            if (std::equal(gamma.begin(), gamma.end(), item_gamma.begin(), item_gamma.end()))
                 return;
 
             this->er->error(item.prod->loc, fmt::format("PSLS conflict between terminals '{}' and '{}', grammar is not LLP(1, 1)", ap.x, ap.y));
@@ -39,13 +59,13 @@ namespace pareas::parser::llp {
         };
 
         for (const auto& set : this->item_sets) {
-            for (const auto& item : set.items) {
+            for (auto id : set.items) {
+                const auto& item = this->items[id];
                 if (item.is_dot_at_begin())
                     continue;
-                const auto& sym = item.sym_before_dot();
-                if (!sym.is_terminal())
+                else if (!ItemTable::is_terminal_code(this->rhs_codes[this->g->production_id(item.prod)][item.dot - 1]))
                     continue;
-                else if (item.lookahead.is_empty() || item.lookback.is_empty())
+                else if (item.lookahead == Grammar::EMPTY_ID || item.lookback == Grammar::EMPTY_ID)
                     continue;
 
                 insert(item);
@@ -96,155 +116,183 @@ namespace pareas::parser::llp {
     void Generator::dump(std::ostream& os) {
         fmt::print(os, "Item sets:\n");
         for (const auto& set : this->item_sets) {
-            set.dump(os);
+            set.dump(os, this->items);
         }
     }
 
+    void Generator::dump_sizes(std::ostream& os) const {
+        fmt::print(os, "Item sets: {}\n", this->item_sets.size());
+        fmt::print(os, "Unique items: {}\n", this->items.size());
+        fmt::print(os, "Unique gammas: {}\n", this->items.num_gammas());
+        fmt::print(os, "Item set construction: {}\n", this->item_set_time);
+    }
+
     void Generator::compute_item_sets() {
         if (!this->item_sets.empty())
             return; // Already computed
 
-        auto queue = std::deque<ItemSet>();
+        auto start = std::chrono::steady_clock::now();
 
-        auto enqueue = [&](const ItemSet& set) {
-            bool inserted = this->item_sets.insert(set).second;
+        // Elements of unordered_set are not moved, so the queue can point into `item_sets`.
+        auto queue = std::deque<const ItemSet*>();
+
+        auto enqueue = [&](ItemSet&& set) {
+            auto [it, inserted] = this->item_sets.insert(std::move(set));
             if (inserted) {
-                queue.emplace_back(set);
+                queue.push_back(&*it);
             }
         };
 
-        {
-            auto initial = ItemSet();
-            initial.items.insert({
-                .prod = this->g->start(),
-                .dot = this->g->start()->rhs.size(),
-                .lookback = Terminal::END_OF_INPUT,
-                .lookahead = Terminal::EMPTY,
-                .gamma = {},
-            });
-
-            enqueue(initial);
-        }
+        enqueue(ItemSet({this->items.intern({
+            .prod = this->g->start(),
+            .dot = this->g->start()->rhs.size(),
+            .lookback = Grammar::END_OF_INPUT_ID,
+            .lookahead = Grammar::EMPTY_ID,
+            .gamma = ItemTable::EMPTY_GAMMA,
+        })}));
 
+        auto syms = std::vector<size_t>();
         while (!queue.empty()) {
-            auto set = queue.front();
+            const auto* set = queue.front();
             queue.pop_front();
 
-            auto syms = set.syms_before_dots();
-            for (const auto& sym : syms) {
-                auto new_set = this->predecessor(set, sym);
-                this->closure(new_set);
-                enqueue(new_set);
+            syms.clear();
+            for (auto id : set->items) {
+                const auto& item = this->items[id];
+                if (!item.is_dot_at_begin())
+                    syms.push_back(this->rhs_codes[this->g->production_id(item.prod)][item.dot - 1]);
+            }
+
+            std::sort(syms.begin(), syms.end());
+            syms.erase(std::unique(syms.begin(), syms.end()), syms.end());
+
+            for (auto sym : syms) {
+                enqueue(this->closure(this->predecessor(*set, sym)));
             }
         }
+
+        this->item_set_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
     }
 
-    ItemSet Generator::predecessor(const ItemSet& set, const Symbol& sym) {
-        auto new_set = ItemSet();
-        for (const auto& item : set.items) {
-            if (item.is_dot_at_begin() || item.sym_before_dot() != sym)
+    std::vector<size_t> Generator::predecessor(const ItemSet& set, size_t sym) {
+        auto new_items = std::vector<size_t>();
+
+        // The lookaheads of the new items are the first set of `sym` followed by the lookahead of the item. If
+        // `sym` can derive the empty string, the lookahead of the item is added instead of the empty terminal.
+        auto first = TerminalSet(this->g->terminals.size());
+        if (ItemTable::is_terminal_code(sym))
+            first.insert(ItemTable::symbol_id(sym));
+        else
+            first = this->tsf->first(ItemTable::symbol_id(sym));
+        bool first_has_empty = first.contains(Grammar::EMPTY_ID);
+        first.erase(Grammar::EMPTY_ID);
+
+        for (auto id : set.items) {
+            // Note: copy, as interning new items may invalidate references.
+            auto item = this->items[id];
+            size_t prod_id = this->g->production_id(item.prod);
+            if (item.is_dot_at_begin() || this->rhs_codes[prod_id][item.dot - 1] != sym)
                 continue;
 
-            auto alpha = item.syms_before_dot();
-            alpha = alpha.subspan(0, alpha.size() - 1);
-
-            auto us = this->tsf->compute_last(alpha);
-            if (us.contains(Terminal::EMPTY)) {
-                const auto& before = this->tsf->before(item.prod->lhs);
+            auto us = this->tsf->last_of_prefix(item.prod, item.dot - 1);
+            if (us.contains(Grammar::EMPTY_ID)) {
+                const auto& before = this->tsf->before(this->g->non_terminal_id(item.prod->lhs));
                 if (!before.empty()) // Special case: Start rule
-                    us.erase(Terminal::EMPTY);
+                    us.erase(Grammar::EMPTY_ID);
                 merge_terminal_sets_omit_empty(us, before);
             }
 
-            Symbol xvi[] = {sym, item.lookahead};
-            auto vs = this->tsf->compute_first(xvi);
+            auto vs = first;
+            if (first_has_empty)
+                vs.insert(item.lookahead);
 
-            for (const auto& u : us) {
-                for (const auto& v : vs) {
-                    auto gamma = this->compute_gamma(v, sym, item.gamma);
-                    new_set.items.insert({
+            for (auto v : vs) {
+                auto gamma = this->compute_gamma(v, sym, item.gamma);
+                for (auto u : us) {
+                    new_items.push_back(this->items.intern({
                         .prod = item.prod,
                         .dot = item.dot - 1,
                         .lookback = u,
                         .lookahead = v,
                         .gamma = gamma,
-                    });
+                    }));
                 }
             }
         }
 
-        return new_set;
+        return new_items;
     }
 
-    void Generator::closure(ItemSet& set) {
-        auto queue = std::deque<Item>();
+    ItemSet Generator::closure(std::vector<size_t> items) {
+        auto seen = std::unordered_set<size_t>();
+        auto queue = std::deque<size_t>();
 
-        auto enqueue = [&](const Item& item) {
-            bool inserted = set.items.insert(item).second;
-            if (item.is_dot_at_begin() || item.sym_before_dot().is_terminal() || !inserted)
-                return;
-            queue.push_back(item);
+        // Only items with a non-terminal before the dot are expanded.
+        auto expands = [&](size_t id) {
+            const auto& item = this->items[id];
+            return !item.is_dot_at_begin() &&
+                !ItemTable::is_terminal_code(this->rhs_codes[this->g->production_id(item.prod)][item.dot - 1]);
         };
 
-        for (const auto& item : set.items) {
-            if (!item.is_dot_at_begin() && !item.sym_before_dot().is_terminal())
-                queue.push_back(item);
+        for (auto id : items) {
+            if (seen.insert(id).second && expands(id))
+                queue.push_back(id);
         }
 
         while (!queue.empty()) {
-            auto item = queue.front();
+            // Note: copy, as interning new items may invalidate references.
+            auto item = this->items[queue.front()];
             queue.pop_front();
 
             // These conditions are guaranteed before inserting an item into the queue.
-            auto nt = item.sym_before_dot().as_non_terminal();
-
-            for (const auto& prod : this->g->productions) {
-                if (prod.lhs != nt)
-                    continue;
-
-                auto us = this->tsf->compute_last(std::span(prod.rhs));
-                if (us.contains(Terminal::EMPTY)) {
-                    us.erase(Terminal::EMPTY);
-                    merge_terminal_sets_omit_empty(us, this->tsf->before(prod.lhs));
-                }
+            auto nt = ItemTable::symbol_id(this->rhs_codes[this->g->production_id(item.prod)][item.dot - 1]);
 
-                for (const auto& u : us) {
-                    enqueue({
-                        .prod = &prod,
-                        .dot = prod.rhs.size(),
+            for (const auto* prod : this->productions_by_lhs[nt]) {
+                for (auto u : this->closure_lookbacks[this->g->production_id(prod)]) {
+                    auto id = this->items.intern({
+                        .prod = prod,
+                        .dot = prod->rhs.size(),
                         .lookback = u,
                         .lookahead = item.lookahead,
                         .gamma = item.gamma,
                     });
+
+                    if (seen.insert(id).second) {
+                        items.push_back(id);
+                        if (expands(id))
+                            queue.push_back(id);
+                    }
                 }
             }
         }
+
+        return ItemSet(std::move(items));
     }
 
-    std::vector<Symbol> Generator::compute_gamma(const Terminal& v, const Symbol& x, std::span<const Symbol> delta) {
-        assert(!x.is_empty_terminal());
-        assert(!v.is_empty());
+    size_t Generator::compute_gamma(size_t v, size_t x, size_t delta) {
+        assert(v != Grammar::EMPTY_ID);
 
-        auto x_delta = std::vector<Symbol>();
+        // Note: copy, as interning the new gamma invalidates the span.
+        auto delta_codes = this->items.gamma_codes(delta);
+        auto x_delta = std::vector<size_t>();
         x_delta.push_back(x);
-        x_delta.insert(x_delta.end(), delta.begin(), delta.end());
-
-        auto gamma = std::vector<Symbol>();
-        for (const auto& sym : x_delta) {
-            gamma.push_back(sym);
-            if (sym.is_terminal()) {
-                assert(sym.as_terminal() == v);
-                return gamma;
-            }
+        x_delta.insert(x_delta.end(), delta_codes.begin(), delta_codes.end());
+
+        for (size_t i = 0; i < x_delta.size(); ++i) {
+            auto sym = x_delta[i];
+            auto gamma = std::span(x_delta).subspan(0, i + 1);
 
-            auto nt = sym.as_non_terminal();
+            if (ItemTable::is_terminal_code(sym)) {
+                assert(ItemTable::symbol_id(sym) == v);
+                return this->items.intern_gamma(gamma);
+            }
 
-            const auto first = this->tsf->first(nt);
+            const auto& first = this->tsf->first(ItemTable::symbol_id(sym));
             if (first.contains(v)) {
-                return gamma;
+                return this->items.intern_gamma(gamma);
             }
 
-            assert(first.contains(Terminal::EMPTY));
+            assert(first.contains(Grammar::EMPTY_ID));
         }
 
         assert(false);
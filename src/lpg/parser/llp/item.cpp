@@ -39,10 +39,89 @@ namespace pareas::parser::llp {
             lhs.dot == rhs.dot &&
             lhs.lookahead == rhs.lookahead &&
             lhs.lookback == rhs.lookback &&
-            std::equal(lhs.gamma.begin(), lhs.gamma.end(), rhs.gamma.begin(), rhs.gamma.end());
+            lhs.gamma == rhs.gamma;
     }
 
-    std::ostream& operator<<(std::ostream& os, const Item& item) {
+    size_t Item::Hash::operator()(const Item& item) const {
+        size_t hash = std::hash<const Production*>{}(item.prod);
+        hash = pareas::hash_combine(hash, std::hash<size_t>{}(item.dot));
+        hash = pareas::hash_combine(hash, std::hash<size_t>{}(item.lookahead));
+        hash = pareas::hash_combine(hash, std::hash<size_t>{}(item.lookback));
+        hash = pareas::hash_combine(hash, std::hash<size_t>{}(item.gamma));
+        return hash;
+    }
+
+    size_t ItemTable::CodesHash::operator()(const std::vector<size_t>& codes) const {
+        return hash_range(codes.begin(), codes.end(), std::hash<size_t>{});
+    }
+
+    ItemTable::ItemTable(const Grammar* g):
+        g(g) {
+        [[maybe_unused]] auto empty = this->intern_gamma({});
+        assert(empty == EMPTY_GAMMA);
+    }
+
+    size_t ItemTable::symbol_code(const Symbol& sym) const {
+        return this->g->symbol_id(sym) * 2 + !sym.is_terminal();
+    }
+
+    bool ItemTable::is_terminal_code(size_t code) {
+        return code % 2 == 0;
+    }
+
+    size_t ItemTable::symbol_id(size_t code) {
+        return code / 2;
+    }
+
+    size_t ItemTable::intern_gamma(std::span<const size_t> codes) {
+        auto key = std::vector<size_t>(codes.begin(), codes.end());
+        auto [it, inserted] = this->gamma_ids.insert({std::move(key), this->gamma_spans.size()});
+        if (!inserted)
+            return it->second;
+
+        this->gamma_spans.push_back({this->gamma_code_arena.size(), codes.size()});
+        for (auto code : codes) {
+            this->gamma_code_arena.push_back(code);
+            if (is_terminal_code(code))
+                this->gamma_symbol_arena.push_back(this->g->terminals[symbol_id(code)]);
+            else
+                this->gamma_symbol_arena.push_back(this->g->non_terminals[symbol_id(code)]);
+        }
+
+        return it->second;
+    }
+
+    std::span<const size_t> ItemTable::gamma_codes(size_t gamma) const {
+        auto [offset, size] = this->gamma_spans[gamma];
+        return std::span(this->gamma_code_arena).subspan(offset, size);
+    }
+
+    std::span<const Symbol> ItemTable::gamma(size_t gamma) const {
+        auto [offset, size] = this->gamma_spans[gamma];
+        return std::span(this->gamma_symbol_arena).subspan(offset, size);
+    }
+
+    size_t ItemTable::num_gammas() const {
+        return this->gamma_spans.size();
+    }
+
+    size_t ItemTable::intern(const Item& item) {
+        auto [it, inserted] = this->item_ids.insert({item, this->items.size()});
+        if (inserted)
+            this->items.push_back(item);
+        return it->second;
+    }
+
+    const Item& ItemTable::operator[](size_t item) const {
+        return this->items[item];
+    }
+
+    size_t ItemTable::size() const {
+        return this->items.size();
+    }
+
+    void ItemTable::dump(std::ostream& os, size_t id) const {
+        const auto& item = this->items[id];
         fmt::print(os, "[{} ->", Symbol(item.prod->lhs));
 
         for (size_t i = 0; i < item.prod->rhs.size(); ++i) {
@@ -54,26 +133,17 @@ namespace pareas::parser::llp {
         if (item.is_dot_at_end())
             fmt::print(os, " •");
 
-        fmt::print(os, ", {}, {},", item.lookback, item.lookahead);
+        fmt::print(os, ", {}, {},", this->g->terminals[item.lookback], this->g->terminals[item.lookahead]);
 
-        if (item.gamma.empty()) {
+        auto gamma = this->gamma(item.gamma);
+        if (gamma.empty()) {
             fmt::print(os, " ε");
         } else {
-            for (const auto& sym : item.gamma) {
+            for (const auto& sym : gamma) {
                 fmt::print(os, " {}", sym);
             }
         }
 
         fmt::print(os, "]");
-        return os;
-    }
-
-    size_t Item::Hash::operator()(const Item& item) const {
-        size_t hash = std::hash<const Production*>{}(item.prod);
-        hash = pareas::hash_combine(hash, std::hash<size_t>{}(item.dot));
-        hash = pareas::hash_combine(hash, Terminal::Hash{}(item.lookahead));
-        hash = pareas::hash_combine(hash, Terminal::Hash{}(item.lookback));
-        hash = pareas::hash_combine(hash, hash_range(item.gamma.begin(), item.gamma.end(), Symbol::Hash{}));
-        return hash;
     }
 }
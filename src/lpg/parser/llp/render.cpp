@@ -7,6 +7,9 @@
 #include <bit>
 #include <unordered_map>
 #include <unordered_set>
+#include <map>
+#include <numeric>
+#include <utility>
 #include <algorithm>
 #include <iterator>
 #include <cstdint>
@@ -22,31 +25,189 @@ namespace {
         int32_t size;
     };
 
+    using Items = std::vector<uint64_t>;
+
+    // Returns the length of the longest proper suffix of `a` that is also a prefix of `b`.
+    size_t overlap(const Items& a, const Items& b) {
+        size_t max = std::min(a.size(), b.size());
+        if (max > 0 && a.size() == b.size())
+            --max;
+
+        for (size_t n = max; n > 0; --n) {
+            if (std::equal(a.end() - n, a.end(), b.begin()))
+                return n;
+        }
+
+        return 0;
+    }
+
+    // Compute a short common superstring of `strings`, using the greedy approximation: strings that are part of
+    // another string are dropped, and then the pair of strings with the largest overlap is merged, until no
+    // overlapping strings remain. The remaining strings are concatenated. `strings` must not contain duplicates.
+    // Returns the superstring, and the offset of every string in it.
+    std::pair<Items, std::vector<size_t>> build_superstring(const std::vector<Items>& strings) {
+        size_t n = strings.size();
+        auto offsets = std::vector<size_t>(n, 0);
+
+        // Visit strings from large to small, so that a string can only be part of a string that is already kept.
+        auto order = std::vector<size_t>(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return strings[a].size() > strings[b].size();
+        });
+
+        auto kept = std::vector<size_t>();
+        // For strings that are dropped, the kept string it is part of, and its position in that string.
+        auto parents = std::vector<std::pair<size_t, size_t>>(n, {0, 0});
+        auto dropped = std::vector<bool>(n, false);
+
+        for (size_t i : order) {
+            const auto& str = strings[i];
+            for (size_t k : kept) {
+                const auto& parent = strings[k];
+                auto it = std::search(parent.begin(), parent.end(), str.begin(), str.end());
+                if (it != parent.end() || str.empty()) {
+                    parents[i] = {k, static_cast<size_t>(it - parent.begin())};
+                    dropped[i] = true;
+                    break;
+                }
+            }
+
+            if (!dropped[i])
+                kept.push_back(i);
+        }
+
+        // All candidate merges, by decreasing overlap. The sort is stable to keep the result deterministic.
+        struct Merge {
+            size_t overlap;
+            size_t a, b;
+        };
+
+        auto merges = std::vector<Merge>();
+        for (size_t a : kept) {
+            for (size_t b : kept) {
+                if (a == b)
+                    continue;
+
+                if (size_t o = overlap(strings[a], strings[b]); o > 0)
+                    merges.push_back({o, a, b});
+            }
+        }
+
+        std::stable_sort(merges.begin(), merges.end(), [](const Merge& x, const Merge& y) {
+            return x.overlap > y.overlap;
+        });
+
+        // Strings are merged into chains. Because no string is part of another string, the overlap between two
+        // chains is the overlap between the last string of the first and the first string of the second chain.
+        // `other_end` holds the other end of the chain for the first and last string of every chain.
+        constexpr const size_t NONE = -1;
+        auto next = std::vector<size_t>(n, NONE);
+        auto prev_overlap = std::vector<size_t>(n, NONE);
+        auto other_end = std::vector<size_t>(n);
+        std::iota(other_end.begin(), other_end.end(), 0);
+
+        for (const auto& [o, a, b] : merges) {
+            // `a` must be the end of a chain, and `b` the start of a different chain.
+            if (next[a] != NONE || prev_overlap[b] != NONE || other_end[b] == a)
+                continue;
+
+            next[a] = b;
+            prev_overlap[b] = o;
+
+            size_t start = other_end[a];
+            size_t end = other_end[b];
+            other_end[start] = end;
+            other_end[end] = start;
+        }
+
+        auto superstring = Items();
+        for (size_t start : kept) {
+            if (prev_overlap[start] != NONE)
+                continue;
+
+            for (size_t i = start; i != NONE; i = next[i]) {
+                size_t skip = prev_overlap[i] == NONE ? 0 : prev_overlap[i];
+                offsets[i] = superstring.size() - skip;
+                superstring.insert(superstring.end(), strings[i].begin() + skip, strings[i].end());
+            }
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            if (dropped[i])
+                offsets[i] = offsets[parents[i].first] + parents[i].second;
+        }
+
+        return {std::move(superstring), std::move(offsets)};
+    }
+
     struct StrTab {
         size_t item_bytes;
         std::vector<uint64_t> superstring;
         std::unordered_map<AdmissiblePair, String, AdmissiblePair::Hash> strings;
 
+        // Statistics
+        size_t total_items;
+        size_t unique_strings;
+        size_t unique_items;
+
         template <typename F>
         StrTab(const ParsingTable& pt, size_t item_bytes, F get_string);
 
-        void render(Renderer* r, const TokenMapping* tm, std::string_view name, std::string_view type);
+        void render(Renderer* r, const TokenMapping* tm, std::string_view name, std::string_view type, Renderer::Element element);
+        void dump_sizes(std::ostream& os, std::string_view name) const;
     };
 
     template <typename F>
     StrTab::StrTab(const ParsingTable& pt, size_t item_bytes, F get_string):
-        item_bytes(item_bytes) {
-        // Simple implementation for now
-        int32_t offset = 0;
+        item_bytes(item_bytes), total_items(0), unique_items(0) {
+        // Many admissible pairs share the same string, so deduplicate them first. The unique strings are
+        // sorted, so that the result does not depend on the iteration order of the parsing table.
+        auto ids = std::map<Items, size_t>();
+        auto pair_strings = std::vector<std::pair<AdmissiblePair, const Items*>>();
+
         for (const auto& [ap, entry] : pt.table) {
-            auto string = get_string(entry);
-            this->superstring.insert(superstring.end(), string.begin(), string.end());
-            this->strings[ap] = {offset, static_cast<int32_t>(string.size())};
-            offset += string.size();
+            auto [it, inserted] = ids.insert({get_string(entry), 0});
+            pair_strings.push_back({ap, &it->first});
+            this->total_items += it->first.size();
+        }
+
+        auto unique = std::vector<Items>();
+        for (auto& [str, id] : ids) {
+            id = unique.size();
+            unique.push_back(str);
+            this->unique_items += str.size();
+        }
+        this->unique_strings = unique.size();
+
+        auto [superstring, offsets] = build_superstring(unique);
+        this->superstring = std::move(superstring);
+
+        for (const auto& [ap, str] : pair_strings) {
+            size_t id = ids.at(*str);
+            assert(offsets[id] + str->size() <= this->superstring.size());
+            assert(std::equal(str->begin(), str->end(), this->superstring.begin() + offsets[id]));
+            this->strings[ap] = {static_cast<int32_t>(offsets[id]), static_cast<int32_t>(str->size())};
         }
     }
 
-    void StrTab::render(Renderer* r, const TokenMapping* tm, std::string_view name, std::string_view type) {
+    void StrTab::dump_sizes(std::ostream& os, std::string_view name) const {
+        fmt::print(
+            os,
+            "{}: {} entries, {} elements ({} bytes) before compression, {} unique strings of {} elements, "
+            "{} elements ({} bytes) after compression\n",
+            name,
+            this->strings.size(),
+            this->total_items,
+            this->total_items * this->item_bytes,
+            this->unique_strings,
+            this->unique_items,
+            this->superstring.size(),
+            this->superstring.size() * this->item_bytes
+        );
+    }
+
+    void StrTab::render(Renderer* r, const TokenMapping* tm, std::string_view name, std::string_view type, Renderer::Element element) {
         size_t n = tm->num_tokens();
         auto stringrefs = std::vector<std::vector<String>>(
             n,
@@ -59,47 +220,36 @@ namespace {
             stringrefs[i][j] = string;
         }
 
-        r->align_data(this->item_bytes);
-        auto table_offset = r->data_offset();
-
-        for (auto value : this->superstring) {
-            r->write_data_int(value, this->item_bytes);
-        }
-
-        r->align_data(sizeof(int32_t));
-        auto offsets_offset = r->data_offset();
+        auto offsets = std::vector<uint64_t>();
+        auto lengths = std::vector<uint64_t>();
 
         for (const auto& v : stringrefs) {
             for (auto str : v) {
                 // According to cppreference, this cast is valid and will produce the desired result.
-                r->write_data_int(static_cast<uint32_t>(str.offset), sizeof(uint32_t));
+                offsets.push_back(static_cast<uint32_t>(str.offset));
+                lengths.push_back(static_cast<uint32_t>(str.size));
             }
         }
 
-        auto lengths_offset = r->data_offset();
-
-        for (const auto& v : stringrefs) {
-            for (auto str : v) {
-                r->write_data_int(static_cast<uint32_t>(str.size), sizeof(uint32_t));
-            }
-        }
+        auto table = r->render_array(fmt::format("{}_table", name), type, this->item_bytes, this->superstring, element);
+        auto offsets_expr = r->render_array(fmt::format("{}_offsets", name), "int32_t", sizeof(int32_t), offsets, Renderer::Element::SIGNED);
+        auto lengths_expr = r->render_array(fmt::format("{}_lengths", name), "int32_t", sizeof(int32_t), lengths, Renderer::Element::SIGNED);
 
-        fmt::print(r->hpp, "extern const StrTab<{}> {};\n", type, name);
-
-        fmt::print(
-            r->cpp,
-            "const StrTab<{}> {}= {{\n"
-            "    .n = {},\n"
-            "    .table = {},\n"
-            "    .offsets = {},\n"
-            "    .lengths = {},\n"
-            "}};\n",
-            type,
+        r->render_definition(
+            fmt::format("const StrTab<{}>", type),
             name,
-            this->superstring.size(),
-            r->render_offset_cast(table_offset, type),
-            r->render_offset_cast(offsets_offset, "int32_t"),
-            r->render_offset_cast(lengths_offset, "int32_t")
+            fmt::format(
+                "{{\n"
+                "    .n = {},\n"
+                "    .table = {},\n"
+                "    .offsets = {},\n"
+                "    .lengths = {},\n"
+                "}}",
+                this->superstring.size(),
+                table,
+                offsets_expr,
+                lengths_expr
+            )
         );
     }
 }
@@ -186,18 +336,55 @@ namespace pareas::parser::llp {
     }
 
     void ParserRenderer::render_production_arity_data() const {
-        this->r->align_data(sizeof(uint32_t));
-        auto offset = this->r->data_offset();
-
-        fmt::print(this->r->hpp, "extern const int32_t* arities; // NUM_PRODUCTIONS\n");
-
-        fmt::print(this->r->cpp, "const int32_t* arities = {};\n", this->r->render_offset_cast(offset, "int32_t"));
-
         // Production id's are assigned according to their index in the
         // productions vector, so we can just write them in order of definition.
+        auto values = std::vector<uint64_t>();
         for (const auto& prod : this->g->productions) {
-            this->r->write_data_int(prod.arity(), sizeof(uint32_t));
+            values.push_back(prod.arity());
         }
+
+        auto arities = this->r->render_array("production_arities", "int32_t", sizeof(int32_t), values, Renderer::Element::SIGNED);
+
+        this->r->render_definition("const int32_t*", "arities", arities);
+    }
+
+    void ParserRenderer::dump_sizes(std::ostream& os) const {
+        auto stack_change_strtab = StrTab(
+            *this->pt,
+            this->bracket_backing_bits() / 8,
+            [&](const ParsingTable::Entry& entry) { return this->stack_change_string(entry); }
+        );
+
+        auto parse_strtab = StrTab(
+            *this->pt,
+            this->g->production_backing_type_bits() / 8,
+            [&](const ParsingTable::Entry& entry) { return this->parse_string(entry); }
+        );
+
+        stack_change_strtab.dump_sizes(os, "Stack change table");
+        parse_strtab.dump_sizes(os, "Parse table");
+    }
+
+    std::vector<uint64_t> ParserRenderer::stack_change_string(const ParsingTable::Entry& entry) const {
+        auto result = std::vector<uint64_t>();
+
+        for (auto it = entry.initial_stack.rbegin(); it != entry.initial_stack.rend(); ++it) {
+            result.push_back(this->bracket_id(*it, false));
+        }
+
+        for (auto it = entry.final_stack.begin(); it != entry.final_stack.end(); ++it) {
+            result.push_back(this->bracket_id(*it, true));
+        }
+
+        return result;
+    }
+
+    std::vector<uint64_t> ParserRenderer::parse_string(const ParsingTable::Entry& entry) const {
+        auto result = std::vector<uint64_t>();
+
+        for (const auto* prod : entry.productions)
+            result.push_back(this->g->production_id(prod));
+        return result;
     }
 
     void ParserRenderer::render_stack_change_table() const {
@@ -206,26 +393,14 @@ namespace pareas::parser::llp {
         auto strtab = StrTab(
             *this->pt,
             bracket_bits / 8,
-            [&](const ParsingTable::Entry& entry) {
-                auto result = std::vector<uint64_t>();
-
-                for (auto it = entry.initial_stack.rbegin(); it != entry.initial_stack.rend(); ++it) {
-                    result.push_back(this->bracket_id(*it, false));
-                }
-
-                for (auto it = entry.final_stack.begin(); it != entry.final_stack.end(); ++it) {
-                    result.push_back(this->bracket_id(*it, true));
-                }
-
-                return result;
-            }
+            [&](const ParsingTable::Entry& entry) { return this->stack_change_string(entry); }
         );
 
         fmt::print(this->r->hpp, "using Bracket = uint{}_t;\n", bracket_bits);
 
         fmt::print(this->r->fut, "module bracket = u{}\n", bracket_bits);
 
-        strtab.render(this->r, this->tm, "stack_change_table", "Bracket");
+        strtab.render(this->r, this->tm, "stack_change_table", "Bracket", Renderer::Element::UNSIGNED);
     }
 
     void ParserRenderer::render_parse_table() const {
@@ -234,15 +409,9 @@ namespace pareas::parser::llp {
         auto strtab = StrTab(
             *this->pt,
             backing_bits / 8,
-            [&](const ParsingTable::Entry& entry) {
-                auto result = std::vector<uint64_t>();
-
-                for (const auto* prod : entry.productions)
-                    result.push_back(this->g->production_id(prod));
-                return result;
-            }
+            [&](const ParsingTable::Entry& entry) { return this->parse_string(entry); }
         );
 
-        strtab.render(this->r, this->tm, "parse_table", "Production");
+        strtab.render(this->r, this->tm, "parse_table", "Production", Renderer::Element::SCOPED_ENUM);
     }
 }
@@ -2,58 +2,210 @@
 
 #include <fmt/ostream.h>
 
+#include <algorithm>
+#include <bit>
 #include <cassert>
 
 namespace pareas::parser {
-    bool merge_terminal_sets_omit_empty(TerminalSet& dst, const TerminalSet& src) {
-        bool changed = false;
-        for (const auto& t : src) {
-            if (t.is_empty())
-                continue;
-            changed |= dst.insert(t).second;
+    TerminalSet::Iterator::Iterator(const TerminalSet* set, size_t id):
+        set(set), id(id) {}
+
+    size_t TerminalSet::Iterator::operator*() const {
+        return this->id;
+    }
+
+    auto TerminalSet::Iterator::operator++() -> Iterator& {
+        this->id = this->set->next(this->id + 1);
+        return *this;
+    }
+
+    bool TerminalSet::Iterator::operator==(const Iterator& other) const {
+        return this->id == other.id;
+    }
+
+    TerminalSet::TerminalSet(size_t num_terminals):
+        words((num_terminals + WORD_BITS - 1) / WORD_BITS, 0) {}
+
+    bool TerminalSet::contains(size_t id) const {
+        size_t word = id / WORD_BITS;
+        return word < this->words.size() && (this->words[word] >> (id % WORD_BITS)) & 1;
+    }
+
+    bool TerminalSet::insert(size_t id) {
+        size_t word = id / WORD_BITS;
+        if (word >= this->words.size())
+            this->words.resize(word + 1, 0);
+
+        auto mask = Word{1} << (id % WORD_BITS);
+        bool inserted = !(this->words[word] & mask);
+        this->words[word] |= mask;
+        return inserted;
+    }
+
+    void TerminalSet::erase(size_t id) {
+        size_t word = id / WORD_BITS;
+        if (word < this->words.size())
+            this->words[word] &= ~(Word{1} << (id % WORD_BITS));
+    }
+
+    bool TerminalSet::empty() const {
+        return std::all_of(this->words.begin(), this->words.end(), [](auto word) { return word == 0; });
+    }
+
+    size_t TerminalSet::size() const {
+        size_t size = 0;
+        for (auto word : this->words)
+            size += std::popcount(word);
+        return size;
+    }
+
+    bool TerminalSet::merge(const TerminalSet& other) {
+        return this->merge_except(other, NONE);
+    }
+
+    bool TerminalSet::merge_except(const TerminalSet& other, size_t id) {
+        if (other.words.size() > this->words.size())
+            this->words.resize(other.words.size(), 0);
+
+        Word changed = 0;
+        for (size_t i = 0; i < other.words.size(); ++i) {
+            auto word = other.words[i];
+            if (i == id / WORD_BITS)
+                word &= ~(Word{1} << (id % WORD_BITS));
+
+            changed |= word & ~this->words[i];
+            this->words[i] |= word;
         }
 
-        return changed;
+        return changed != 0;
+    }
+
+    auto TerminalSet::begin() const -> Iterator {
+        return Iterator(this, this->next(0));
     }
 
-    TerminalSetFunctions::TerminalSetFunctions(const Grammar& g) {
-        this->base_first_sets = this->compute_base_first_or_last_set(g, true);
-        this->base_last_sets = this->compute_base_first_or_last_set(g, false);
+    auto TerminalSet::end() const -> Iterator {
+        return Iterator(this, this->words.size() * WORD_BITS);
+    }
+
+    bool TerminalSet::operator==(const TerminalSet& other) const {
+        // Sets of different widths may still hold the same terminals.
+        size_t n = std::max(this->words.size(), other.words.size());
+        for (size_t i = 0; i < n; ++i) {
+            auto a = i < this->words.size() ? this->words[i] : 0;
+            auto b = i < other.words.size() ? other.words[i] : 0;
+            if (a != b)
+                return false;
+        }
 
-        this->follow_sets = this->compute_follow_or_before_sets(g, true);
-        this->before_sets = this->compute_follow_or_before_sets(g, false);
+        return true;
+    }
+
+    size_t TerminalSet::next(size_t id) const {
+        size_t word = id / WORD_BITS;
+        if (word >= this->words.size())
+            return this->words.size() * WORD_BITS;
+
+        // Mask off the bits before `id` in its word.
+        auto bits = this->words[word] & (~Word{0} << (id % WORD_BITS));
+        while (bits == 0) {
+            if (++word == this->words.size())
+                return this->words.size() * WORD_BITS;
+            bits = this->words[word];
+        }
+
+        return word * WORD_BITS + std::countr_zero(bits);
+    }
+
+    bool merge_terminal_sets_omit_empty(TerminalSet& dst, const TerminalSet& src) {
+        return dst.merge_except(src, Grammar::EMPTY_ID);
+    }
+
+    TerminalSetFunctions::TerminalSetFunctions(const Grammar& g):
+        g(&g) {
+        this->rhs_ids.reserve(g.productions.size());
+        for (const auto& prod : g.productions) {
+            auto& ids = this->rhs_ids.emplace_back();
+            for (const auto& sym : prod.rhs)
+                ids.push_back(g.symbol_id(sym));
+        }
+
+        this->base_first_sets = this->compute_base_first_or_last_set(true);
+        this->base_last_sets = this->compute_base_first_or_last_set(false);
+
+        this->follow_sets = this->compute_follow_or_before_sets(true);
+        this->before_sets = this->compute_follow_or_before_sets(false);
+
+        this->prefix_last_sets.reserve(g.productions.size());
+        for (size_t i = 0; i < g.productions.size(); ++i) {
+            const auto& rhs = g.productions[i].rhs;
+            auto& sets = this->prefix_last_sets.emplace_back();
+            for (size_t n = 0; n <= rhs.size(); ++n) {
+                sets.push_back(this->compute_first_or_last_set(
+                    std::span(rhs).subspan(0, n),
+                    std::span(this->rhs_ids[i]).subspan(0, n),
+                    false
+                ));
+            }
+        }
     }
 
     const TerminalSet& TerminalSetFunctions::first(const NonTerminal& nt) const {
-        return this->base_first_sets.at(nt);
+        return this->first(this->g->non_terminal_id(nt));
     }
 
     const TerminalSet& TerminalSetFunctions::last(const NonTerminal& nt) const {
-        return this->base_last_sets.at(nt);
+        return this->last(this->g->non_terminal_id(nt));
     }
 
     const TerminalSet& TerminalSetFunctions::follow(const NonTerminal& nt) const {
-        return this->follow_sets.at(nt);
+        return this->follow(this->g->non_terminal_id(nt));
     }
 
     const TerminalSet& TerminalSetFunctions::before(const NonTerminal& nt) const {
-        return this->before_sets.at(nt);
+        return this->before(this->g->non_terminal_id(nt));
+    }
+
+    const TerminalSet& TerminalSetFunctions::first(size_t nt) const {
+        return this->base_first_sets[nt];
+    }
+
+    const TerminalSet& TerminalSetFunctions::last(size_t nt) const {
+        return this->base_last_sets[nt];
+    }
+
+    const TerminalSet& TerminalSetFunctions::follow(size_t nt) const {
+        return this->follow_sets[nt];
+    }
+
+    const TerminalSet& TerminalSetFunctions::before(size_t nt) const {
+        return this->before_sets[nt];
     }
 
     TerminalSet TerminalSetFunctions::compute_first(std::span<const Symbol> symbols) const {
-        return this->compute_first_or_last_set(symbols, true);
+        auto ids = std::vector<size_t>();
+        for (const auto& sym : symbols)
+            ids.push_back(this->g->symbol_id(sym));
+        return this->compute_first_or_last_set(symbols, ids, true);
     }
 
     TerminalSet TerminalSetFunctions::compute_last(std::span<const Symbol> symbols) const {
-        return this->compute_first_or_last_set(symbols, false);
+        auto ids = std::vector<size_t>();
+        for (const auto& sym : symbols)
+            ids.push_back(this->g->symbol_id(sym));
+        return this->compute_first_or_last_set(symbols, ids, false);
+    }
+
+    const TerminalSet& TerminalSetFunctions::last_of_prefix(const Production* prod, size_t n) const {
+        return this->prefix_last_sets[this->g->production_id(prod)][n];
     }
 
     void TerminalSetFunctions::dump(std::ostream& os) {
         auto dump_nt_ts = [&](const auto& sets){
-            for (auto [nt, set] : sets) {
-                fmt::print(os, "    {}:\t", nt);
-                for (const auto& t : set) {
-                    fmt::print(os, " {}", t);
+            for (size_t nt = 0; nt < sets.size(); ++nt) {
+                fmt::print(os, "    {}:\t", this->g->non_terminals[nt]);
+                for (auto t : sets[nt]) {
+                    fmt::print(os, " {}", this->g->terminals[t]);
                 }
                 fmt::print(os, "\n");
             }
@@ -72,82 +224,80 @@ namespace pareas::parser {
         dump_nt_ts(this->before_sets);
     }
 
-    TerminalSetMap TerminalSetFunctions::compute_base_first_or_last_set(const Grammar& g, bool first) const {
-        auto sets = TerminalSetMap();
+    TerminalSetMap TerminalSetFunctions::compute_base_first_or_last_set(bool first) const {
+        auto sets = TerminalSetMap(this->g->non_terminals.size(), TerminalSet(this->g->terminals.size()));
 
-        auto add_prod = [&](const Production& prod) {
+        auto add_prod = [&](size_t prod_id) {
+            const auto& prod = this->g->productions[prod_id];
+            const auto& ids = this->rhs_ids[prod_id];
+            auto& dst_set = sets[this->g->non_terminal_id(prod.lhs)];
             bool changed = false;
 
             for (size_t i = 0; i < prod.rhs.size(); ++i) {
-                const auto& sym = first ? prod.rhs[i] : prod.rhs[prod.rhs.size() - i - 1];
+                size_t j = first ? i : prod.rhs.size() - i - 1;
+                const auto& sym = prod.rhs[j];
 
                 if (sym.is_empty_terminal()) {
                     continue;
                 } else if (sym.is_terminal()) {
-                    changed |= sets[prod.lhs].insert(sym.as_terminal()).second;
+                    changed |= dst_set.insert(ids[j]);
                     return changed;
                 } else {
-                    auto dst_set = sets[prod.lhs]; // be lazy and copy for now
-                    const auto& sym_set = sets[sym.as_non_terminal()];
-                    bool sym_set_has_empty = sym_set.contains(Terminal::EMPTY);
-
+                    // Copy, as the symbol may be the left hand side itself.
+                    auto sym_set = sets[ids[j]];
                     changed |= merge_terminal_sets_omit_empty(dst_set, sym_set);
-                    sets[prod.lhs] = dst_set;
 
-                    if (!sym_set_has_empty)
+                    if (!sym_set.contains(Grammar::EMPTY_ID))
                         return changed;
                 }
             }
 
-            changed |= sets[prod.lhs].insert(Terminal::EMPTY).second;
+            changed |= dst_set.insert(Grammar::EMPTY_ID);
             return changed;
         };
 
         bool changed = true;
         while (changed) {
             changed = false;
-            for (const auto& prod : g.productions) {
-                changed |= add_prod(prod);
+            for (size_t i = 0; i < this->g->productions.size(); ++i) {
+                changed |= add_prod(i);
             }
         }
 
         return sets;
     }
 
-    TerminalSetMap TerminalSetFunctions::compute_follow_or_before_sets(const Grammar& g, bool follow) const {
-        auto sets = TerminalSetMap();
+    TerminalSetMap TerminalSetFunctions::compute_follow_or_before_sets(bool follow) const {
+        // Every non-terminal is present, also those with an empty follow/before set.
+        auto sets = TerminalSetMap(this->g->non_terminals.size(), TerminalSet(this->g->terminals.size()));
 
-        // Pre-insert left-hand sides: this will both make sure that a key is allocated
-        // (allowing us to omit a copy), and will make sure that any LHS with empty follow/
-        // before set is present
-        for (const auto& prod : g.productions) {
-            sets.insert({prod.lhs, {}});
-        }
-
-        auto add_prod = [&](const Production& prod) {
+        auto add_prod = [&](size_t prod_id) {
+            const auto& prod = this->g->productions[prod_id];
+            const auto& ids = this->rhs_ids[prod_id];
+            size_t lhs = this->g->non_terminal_id(prod.lhs);
             bool changed = false;
 
             for (size_t i = 0; i < prod.rhs.size(); ++i) {
                 const auto& sym = prod.rhs[i];
                 if (sym.is_terminal())
                     continue;
-                auto nt = sym.as_non_terminal();
+                size_t nt = ids[i];
 
                 auto b = follow ?
                     std::span(prod.rhs).subspan(i + 1) :
                     std::span(prod.rhs).subspan(0, i);
+                auto b_ids = follow ?
+                    std::span(ids).subspan(i + 1) :
+                    std::span(ids).subspan(0, i);
 
-                auto ts = this->compute_first_or_last_set(b, follow);
-                // Should be pre-inserted. If not, there is no production which has this
-                // symbol as LHS.
-                auto set = sets.at(nt);
+                auto ts = this->compute_first_or_last_set(b, b_ids, follow);
 
-                changed = merge_terminal_sets_omit_empty(set, ts);
-                if (ts.contains(Terminal::EMPTY)) {
-                    changed |= merge_terminal_sets_omit_empty(set, sets[prod.lhs]);
+                changed = merge_terminal_sets_omit_empty(sets[nt], ts);
+                if (ts.contains(Grammar::EMPTY_ID)) {
+                    // Copy, as `nt` may be the left hand side itself.
+                    auto lhs_set = sets[lhs];
+                    changed |= merge_terminal_sets_omit_empty(sets[nt], lhs_set);
                 }
-
-                sets[nt] = set;
             }
 
             return changed;
@@ -157,37 +307,38 @@ namespace pareas::parser {
         while (changed) {
             changed = false;
 
-            for (const auto& prod : g.productions) {
-                changed |= add_prod(prod);
+            for (size_t i = 0; i < this->g->productions.size(); ++i) {
+                changed |= add_prod(i);
             }
         }
 
         return sets;
     }
 
-    TerminalSet TerminalSetFunctions::compute_first_or_last_set(std::span<const Symbol> symbols, bool first) const {
-        auto set = TerminalSet();
+    TerminalSet TerminalSetFunctions::compute_first_or_last_set(std::span<const Symbol> symbols, std::span<const size_t> ids, bool first) const {
+        assert(symbols.size() == ids.size());
+        auto set = TerminalSet(this->g->terminals.size());
         const auto& base_sets = first ? this->base_first_sets : this->base_last_sets;
 
         for (size_t i = 0; i < symbols.size(); ++i) {
-            const auto& sym = first ? symbols[i] : symbols[symbols.size() - i - 1];
+            size_t j = first ? i : symbols.size() - i - 1;
+            const auto& sym = symbols[j];
             if (sym.is_empty_terminal()) {
                 continue;
             } if (sym.is_terminal()) {
-                set.insert(sym.as_terminal());
+                set.insert(ids[j]);
                 return set;
             }
 
-            auto nt = sym.as_non_terminal();
-            const auto& ts = base_sets.at(nt);
+            const auto& ts = base_sets[ids[j]];
             merge_terminal_sets_omit_empty(set, ts);
 
-            if (!ts.contains(Terminal::EMPTY)) {
+            if (!ts.contains(Grammar::EMPTY_ID)) {
                 return set;
             }
         }
 
-        set.insert(Terminal::EMPTY);
+        set.insert(Grammar::EMPTY_ID);
         return set;
     }
 }
@@ -1,9 +1,11 @@
 #include "pareas/lpg/renderer.hpp"
 
 #include <fmt/ostream.h>
+#include <fmt/format.h>
 
 #include <algorithm>
 #include <string>
+#include <iterator>
 #include <bit>
 #include <cassert>
 
@@ -22,12 +24,12 @@ namespace {
 }
 
 namespace pareas {
-    Renderer::Renderer(const char* namesp, const std::filesystem::path& output):
+    Renderer::Renderer(const char* namesp, const std::filesystem::path& output, Emit emit):
         namesp(namesp),
+        emit(emit),
         fut(open_output(output, ".fut")),
         hpp(open_output(output, ".hpp")),
-        cpp(open_output(output, ".cpp")),
-        dat(open_output(output, ".dat")) {
+        cpp(open_output(output, ".cpp")) {
 
         auto namesp_upper = std::string(this->namesp);
         std::transform(namesp_upper.begin(), namesp_upper.end(), namesp_upper.begin(), ::toupper);
@@ -39,20 +41,23 @@ namespace pareas {
             "\n"
             "#include <cstdint>\n"
             "#include <cstddef>\n"
+            "{2}"
             "\n"
             "namespace {1} {{\n",
             namesp_upper,
-            this->namesp
+            this->namesp,
+            this->emit == Emit::CONSTEXPR ? "#include <array>\n" : ""
         );
 
-        fmt::print(
-            this->cpp,
-            "#include \"{0}.hpp\"\n"
-            "extern \"C\" const uint8_t _{1}_data[];\n"
-            "namespace {1} {{\n",
-            output.filename().c_str(),
-            this->namesp
-        );
+        fmt::print(this->cpp, "#include \"{}.hpp\"\n", output.filename().c_str());
+        if (this->emit == Emit::INCBIN)
+            fmt::print(this->cpp, "extern \"C\" const uint8_t _{}_data[];\n", this->namesp);
+        fmt::print(this->cpp, "namespace {} {{\n", this->namesp);
+
+        if (this->emit == Emit::CONSTEXPR)
+            return;
+
+        this->dat = open_output(output, ".dat");
 
         auto asm_out = open_output(output, ".S");
         fmt::print(
@@ -71,6 +76,60 @@ namespace pareas {
         fmt::print(this->cpp, "}}\n");
     }
 
+    std::string Renderer::render_array(
+        std::string_view name,
+        std::string_view type,
+        size_t bytes,
+        std::span<const uint64_t> values,
+        Element element
+    ) {
+        if (this->emit == Emit::INCBIN) {
+            this->align_data(bytes);
+            auto offset = this->data_offset();
+            for (auto value : values)
+                this->write_data_int(value, bytes);
+            return this->render_offset_cast(offset, type);
+        }
+
+        // Tables may have millions of elements, so format them into a single buffer.
+        auto buf = fmt::memory_buffer();
+        fmt::format_to(std::back_inserter(buf), "inline constexpr std::array<{}, {}> {} = {{", type, values.size(), name);
+        for (size_t i = 0; i < values.size(); ++i) {
+            auto value = values[i];
+            assert(bytes == 8 || value < (1ULL << (8ULL * bytes)));
+            if (i % 16 == 0)
+                fmt::format_to(std::back_inserter(buf), "\n   ");
+
+            switch (element) {
+                case Element::UNSIGNED:
+                    fmt::format_to(std::back_inserter(buf), " {},", value);
+                    break;
+                case Element::SIGNED: {
+                    // Sign-extend the value from `bytes` to 64 bits.
+                    auto shift = 64 - 8 * bytes;
+                    fmt::format_to(std::back_inserter(buf), " {},", static_cast<int64_t>(value << shift) >> shift);
+                    break;
+                }
+                case Element::SCOPED_ENUM:
+                    fmt::format_to(std::back_inserter(buf), " {}{{{}}},", type, value);
+                    break;
+            }
+        }
+        fmt::format_to(std::back_inserter(buf), "\n}};\n");
+        this->hpp.write(buf.data(), buf.size());
+
+        return fmt::format("{}.data()", name);
+    }
+
+    void Renderer::render_definition(std::string_view type, std::string_view name, std::string_view init) {
+        if (this->emit == Emit::INCBIN) {
+            fmt::print(this->hpp, "extern {} {};\n", type, name);
+            fmt::print(this->cpp, "{} {} = {};\n", type, name, init);
+        } else {
+            fmt::print(this->hpp, "inline constexpr {} {} = {};\n", type, name, init);
+        }
+    }
+
     void Renderer::align_data(size_t align) {
         auto offset = this->data_offset();
         auto diff = (align - offset % align) % align;
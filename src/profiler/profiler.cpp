@@ -3,29 +3,91 @@
 #include <fmt/ostream.h>
 #include <fmt/chrono.h>
 
+#include <algorithm>
+#include <numeric>
+#include <iterator>
+#include <string>
+#include <unordered_map>
 #include <cstddef>
+#include <cmath>
 #include <cassert>
 
+namespace {
+    using Profiler = pareas::Profiler;
+
+    int64_t to_us(Profiler::Clock::duration d) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    }
+
+    // Thread ids are not very readable, so number them in order of appearance.
+    struct ThreadNumbering {
+        std::unordered_map<std::thread::id, size_t> ids;
+
+        size_t operator()(std::thread::id id) {
+            return this->ids.try_emplace(id, this->ids.size() + 1).first->second;
+        }
+    };
+
+    std::string json_escape(std::string_view str) {
+        auto result = std::string();
+        for (char c : str) {
+            switch (c) {
+                case '"': result += "\\\""; break;
+                case '\\': result += "\\\\"; break;
+                case '\n': result += "\\n"; break;
+                case '\t': result += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20)
+                        result += fmt::format("\\u{:04x}", static_cast<unsigned>(c));
+                    else
+                        result.push_back(c);
+            }
+        }
+        return result;
+    }
+
+    std::string csv_escape(std::string_view str) {
+        if (str.find_first_of(",\"\n") == std::string_view::npos)
+            return std::string(str);
+
+        auto result = std::string("\"");
+        for (char c : str) {
+            if (c == '"')
+                result.push_back('"');
+            result.push_back(c);
+        }
+        result.push_back('"');
+        return result;
+    }
+}
+
 namespace pareas {
     Profiler::Profiler(unsigned max_level):
         max_level(max_level),
         level(0),
-        sync_callback(null_callback) {
+        sync_callback(null_callback),
+        sync_mode(SyncMode::EAGER),
+        origin(Clock::now()) {
     }
 
     void Profiler::set_sync_callback(SyncCallback sync_callback) {
         this->sync_callback = sync_callback;
     }
 
+    void Profiler::set_sync_mode(SyncMode sync_mode) {
+        this->sync_mode = sync_mode;
+    }
+
     void Profiler::begin() {
         ++this->level;
         if (this->level > this->max_level)
             return;
 
-        this->sync_callback();
+        if (this->sync_mode == SyncMode::EAGER || this->starts.empty())
+            this->sync_callback();
 
         auto start = Clock::now();
-        this->starts.push_back(start);
+        this->starts.push_back({start, std::this_thread::get_id(), {}});
     }
 
     void Profiler::end(const char* name) {
@@ -33,18 +95,116 @@ namespace pareas {
         if (this->level >= this->max_level)
             return;
 
-        this->sync_callback();
+        bool synced = this->sync_mode == SyncMode::EAGER || this->starts.size() == 1;
+        if (synced)
+            this->sync_callback();
 
         auto end = Clock::now();
-        auto start = this->starts.back();
+        auto region = std::move(this->starts.back());
         this->starts.pop_back();
-        auto diff = end - start;
-        this->history.push_back(HistoryEntry{this->level, name, diff});
+        auto diff = end - region.start;
+        this->history.push_back(HistoryEntry{
+            this->level,
+            name,
+            region.start,
+            diff,
+            region.thread,
+            std::move(region.counters),
+            synced
+        });
+    }
+
+    void Profiler::count(const char* name, int64_t value) {
+        // If the current region is not recorded, the counter is attributed to the innermost region that is.
+        if (this->starts.empty())
+            return;
+
+        auto& counters = this->starts.back().counters;
+        for (auto& counter : counters) {
+            if (std::string_view(counter.name) == name) {
+                counter.value += value;
+                return;
+            }
+        }
+
+        counters.push_back({name, value});
+    }
+
+    void Profiler::append(const Profiler& other, const char* name) {
+        assert(other.level == 0);
+
+        ++this->level;
+        if (this->level > this->max_level) {
+            --this->level;
+            return;
+        }
+
+        auto start = Clock::time_point::max();
+        auto end = Clock::time_point::min();
+        for (const auto& entry : other.history) {
+            start = std::min(start, entry.start);
+            end = std::max(end, entry.start + entry.elapsed);
+
+            // Children are recorded before their parents, see `regions`.
+            if (entry.level + this->level < this->max_level) {
+                auto child = entry;
+                child.level += this->level;
+                this->history.push_back(std::move(child));
+            }
+        }
+
+        --this->level;
+        if (other.history.empty())
+            start = end = Clock::now();
+
+        this->history.push_back(HistoryEntry{
+            this->level,
+            name,
+            start,
+            end - start,
+            std::this_thread::get_id(),
+            {},
+            true
+        });
     }
 
-    void Profiler::dump(std::ostream& os) {
+    void Profiler::dump(std::ostream& os, Format format) const {
         assert(this->level == 0);
 
+        switch (format) {
+            case Format::TEXT:
+                this->dump_text(os);
+                break;
+            case Format::CHROME_TRACE:
+                this->dump_chrome_trace(os);
+                break;
+            case Format::CSV:
+                this->dump_csv(os);
+                break;
+        }
+    }
+
+    std::optional<Profiler::Format> Profiler::parse_format(std::string_view name) {
+        if (name == "text")
+            return Format::TEXT;
+        else if (name == "chrome")
+            return Format::CHROME_TRACE;
+        else if (name == "csv")
+            return Format::CSV;
+        return std::nullopt;
+    }
+
+    std::optional<Profiler::SyncMode> Profiler::parse_sync_mode(std::string_view name) {
+        if (name == "eager")
+            return SyncMode::EAGER;
+        else if (name == "lazy")
+            return SyncMode::LAZY;
+        return std::nullopt;
+    }
+
+    std::vector<std::pair<std::string, Profiler::HistoryEntry>> Profiler::regions() const {
+        // Regions are recorded when they end, so children appear before their parents. Reorder
+        // the history such that every region is followed by its children.
         auto ordered_history = std::vector<HistoryEntry>(this->history.size());
         auto level_index_stack = std::vector<size_t>();
 
@@ -59,13 +219,162 @@ namespace pareas {
             level_index_stack.pop_back();
         }
 
+        auto regions = std::vector<std::pair<std::string, HistoryEntry>>();
         auto name_stack = std::vector<const char*>();
-        for (auto [level, name, elapsed] : ordered_history) {
-            name_stack.resize(level);
-            name_stack.push_back(name);
+        for (auto& entry : ordered_history) {
+            name_stack.resize(entry.level);
+            name_stack.push_back(entry.name);
+            regions.emplace_back(fmt::format("{}", fmt::join(name_stack, ".")), std::move(entry));
+        }
+
+        return regions;
+    }
+
+    void Profiler::dump_text(std::ostream& os) const {
+        for (const auto& [path, entry] : this->regions()) {
+            auto us = std::chrono::duration_cast<std::chrono::microseconds>(entry.elapsed);
+            fmt::print(os, "{}: {}{}\n", path, us, entry.synced ? "" : " (enqueue only)");
+            for (auto [name, value] : entry.counters) {
+                fmt::print(os, "{} [{}]: {}\n", path, name, value);
+            }
+        }
+    }
+
+    void Profiler::dump_chrome_trace(std::ostream& os) const {
+        auto thread_numbering = ThreadNumbering();
+        bool first = true;
+
+        fmt::print(os, "{{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+        for (const auto& [path, entry] : this->regions()) {
+            // Complete events (ph = X) carry both the begin timestamp and the duration, and
+            // nesting is derived from the timestamps.
+            fmt::print(
+                os,
+                "{}\n{{\"name\":\"{}\",\"cat\":\"pareas\",\"ph\":\"X\",\"ts\":{},\"dur\":{},\"pid\":1,\"tid\":{},\"args\":{{\"path\":\"{}\",\"level\":{},\"synced\":{}",
+                first ? "" : ",",
+                json_escape(entry.name),
+                to_us(entry.start - this->origin),
+                to_us(entry.elapsed),
+                thread_numbering(entry.thread),
+                json_escape(path),
+                entry.level,
+                entry.synced
+            );
+            for (auto [name, value] : entry.counters) {
+                fmt::print(os, ",\"{}\":{}", json_escape(name), value);
+            }
+            fmt::print(os, "}}}}");
+            first = false;
+        }
+        fmt::print(os, "\n]}}\n");
+    }
+
+    void Profiler::dump_csv(std::ostream& os) const {
+        auto thread_numbering = ThreadNumbering();
 
-            auto us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed);
-            fmt::print("{}: {}\n", fmt::join(name_stack, "."), us);
+        fmt::print(os, "path,level,start_us,elapsed_us,synced,thread,counters\n");
+        for (const auto& [path, entry] : this->regions()) {
+            auto counters = std::string();
+            for (auto [name, value] : entry.counters) {
+                if (!counters.empty())
+                    counters.push_back(';');
+                counters += fmt::format("{}={}", name, value);
+            }
+
+            fmt::print(
+                os,
+                "{},{},{},{},{},{},{}\n",
+                csv_escape(path),
+                entry.level,
+                to_us(entry.start - this->origin),
+                to_us(entry.elapsed),
+                entry.synced,
+                thread_numbering(entry.thread),
+                csv_escape(counters)
+            );
+        }
+    }
+
+    void ProfileStatistics::add(const Profiler& p) {
+        for (const auto& [path, entry] : p.regions()) {
+            auto it = std::find_if(this->regions.begin(), this->regions.end(), [&, &path = path](const auto& region) {
+                return region.path == path;
+            });
+
+            if (it == this->regions.end()) {
+                this->regions.push_back({path, {}, true});
+                it = std::prev(this->regions.end());
+            }
+
+            it->samples.push_back(entry.elapsed);
+            it->synced = it->synced && entry.synced;
+        }
+    }
+
+    void ProfileStatistics::dump(std::ostream& os, Profiler::Format format, size_t bytes) const {
+        bool csv = format == Profiler::Format::CSV;
+        if (csv)
+            fmt::print(os, "path,runs,min_us,median_us,p95_us,mean_us,stddev_us,synced{}\n", bytes > 0 ? ",gb_per_s" : "");
+
+        for (const auto& region : this->regions) {
+            auto samples = std::vector<double>();
+            for (auto sample : region.samples) {
+                samples.push_back(std::chrono::duration<double, std::micro>(sample).count());
+            }
+            std::sort(samples.begin(), samples.end());
+
+            size_t n = samples.size();
+            double mean = std::accumulate(samples.begin(), samples.end(), 0.0) / n;
+            double variance = 0;
+            for (double x : samples) {
+                variance += (x - mean) * (x - mean);
+            }
+            double stddev = n > 1 ? std::sqrt(variance / (n - 1)) : 0;
+
+            // Nearest-rank percentiles.
+            auto percentile = [&](double p) {
+                size_t rank = static_cast<size_t>(std::ceil(p * n));
+                return samples[std::clamp<size_t>(rank, 1, n) - 1];
+            };
+
+            double median = n % 2 == 1 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+
+            // Bytes per microsecond, divided by 1000, is gigabytes per second.
+            double throughput = median > 0 ? bytes / median / 1000 : 0;
+
+            if (csv) {
+                fmt::print(
+                    os,
+                    "{},{},{:.1f},{:.1f},{:.1f},{:.1f},{:.1f},{}",
+                    csv_escape(region.path),
+                    n,
+                    samples.front(),
+                    median,
+                    percentile(0.95),
+                    mean,
+                    stddev,
+                    region.synced
+                );
+
+                if (bytes > 0)
+                    fmt::print(os, ",{:.3f}", throughput);
+                fmt::print(os, "\n");
+            } else {
+                fmt::print(
+                    os,
+                    "{}: min={:.1f}us median={:.1f}us p95={:.1f}us mean={:.1f}us stddev={:.1f}us",
+                    region.path,
+                    samples.front(),
+                    median,
+                    percentile(0.95),
+                    mean,
+                    stddev
+                );
+
+                if (bytes > 0)
+                    fmt::print(os, " throughput={:.3f}GB/s", throughput);
+                fmt::print(os, " (runs={}{})\n", n, region.synced ? "" : ", enqueue only");
+            }
         }
     }
 }
@@ -0,0 +1,372 @@
+// Generator for synthetic JSON documents, used to benchmark the json parser. The document is a top-level array
+// of values which is extended until it reaches the requested size. The output is streamed, so documents of
+// several gigabytes can be generated without keeping them in memory.
+
+#include <fmt/format.h>
+#include <fmt/ostream.h>
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+
+namespace {
+    struct Options {
+        const char* output_path;
+        bool help;
+        uint64_t seed;
+        uint64_t size;
+        unsigned max_depth;
+        unsigned fanout;
+        double string_length;
+        double number_density;
+    };
+
+    void print_usage(char* progname) {
+        fmt::print(
+            "Usage: {} [options...]\n"
+            "Available options:\n"
+            "-o --output <output path>   Write the document to <output path>. (default: -)\n"
+            "-h --help                   Show this message and exit.\n"
+            "--seed <seed>               Seed of the random number generator. (default: 0)\n"
+            "--size <bytes>              Approximate size of the document. The suffixes k, M\n"
+            "                            and G multiply the size by 2^10, 2^20 and 2^30\n"
+            "                            respectively. (default: 1M)\n"
+            "--depth <depth>             Maximum nesting depth of arrays and objects within\n"
+            "                            the top-level array. (default: 8)\n"
+            "--fanout <amount>           Maximum number of elements of an array or object.\n"
+            "                            (default: 8)\n"
+            "--string-length <length>    Mean length of strings. Lengths are geometrically\n"
+            "                            distributed. (default: 16)\n"
+            "--number-density <p>        Fraction of scalar values that are numbers. Other\n"
+            "                            scalars are mostly strings. (default: 0.5)\n"
+            "\n"
+            "When <output path> is '-', the document is written to standard output.\n",
+            progname
+        );
+    }
+
+    template <typename T>
+    bool parse_number(std::string_view arg, const char* option, T* value) {
+        const auto* end = arg.data() + arg.size();
+        auto [p, ec] = std::from_chars(arg.data(), end, *value);
+        if (ec != std::errc() || p != end) {
+            fmt::print(std::cerr, "Error: Invalid value '{}' for option {}\n", arg, option);
+            return false;
+        }
+        return true;
+    }
+
+    bool parse_size(std::string_view arg, const char* option, uint64_t* value) {
+        unsigned shift = 0;
+        if (!arg.empty()) {
+            switch (arg.back()) {
+                case 'k': case 'K': shift = 10; break;
+                case 'M': shift = 20; break;
+                case 'G': shift = 30; break;
+            }
+        }
+
+        if (shift > 0)
+            arg.remove_suffix(1);
+
+        if (!parse_number(arg, option, value))
+            return false;
+
+        *value <<= shift;
+        return true;
+    }
+
+    bool parse_options(Options* opts, int argc, char* argv[]) {
+        *opts = {
+            .output_path = nullptr,
+            .help = false,
+            .seed = 0,
+            .size = 1 << 20,
+            .max_depth = 8,
+            .fanout = 8,
+            .string_length = 16,
+            .number_density = 0.5,
+        };
+
+        for (int i = 1; i < argc; ++i) {
+            auto arg = std::string_view(argv[i]);
+
+            if (arg == "-h" || arg == "--help") {
+                opts->help = true;
+                continue;
+            } else if (arg.size() <= 1 || arg[0] != '-') {
+                fmt::print(std::cerr, "Error: Unexpected argument {}\n", arg);
+                return false;
+            } else if (++i >= argc) {
+                fmt::print(std::cerr, "Error: Expected argument to option {}\n", arg);
+                return false;
+            }
+
+            bool ok = true;
+            if (arg == "-o" || arg == "--output") {
+                opts->output_path = argv[i];
+            } else if (arg == "--seed") {
+                ok = parse_number(argv[i], argv[i - 1], &opts->seed);
+            } else if (arg == "--size") {
+                ok = parse_size(argv[i], argv[i - 1], &opts->size);
+            } else if (arg == "--depth") {
+                ok = parse_number(argv[i], argv[i - 1], &opts->max_depth);
+            } else if (arg == "--fanout") {
+                ok = parse_number(argv[i], argv[i - 1], &opts->fanout);
+            } else if (arg == "--string-length") {
+                ok = parse_number(argv[i], argv[i - 1], &opts->string_length);
+            } else if (arg == "--number-density") {
+                ok = parse_number(argv[i], argv[i - 1], &opts->number_density);
+            } else {
+                fmt::print(std::cerr, "Error: Unknown option {}\n", arg);
+                return false;
+            }
+
+            if (!ok)
+                return false;
+        }
+
+        if (opts->help)
+            return true;
+
+        if (!opts->output_path) {
+            opts->output_path = "-";
+        } else if (!opts->output_path[0]) {
+            fmt::print(std::cerr, "Error: <output path> may not be empty\n");
+            return false;
+        }
+
+        if (opts->fanout < 1) {
+            fmt::print(std::cerr, "Error: --fanout must be at least 1\n");
+            return false;
+        } else if (opts->string_length < 0) {
+            fmt::print(std::cerr, "Error: --string-length may not be negative\n");
+            return false;
+        } else if (opts->number_density < 0 || opts->number_density > 1) {
+            fmt::print(std::cerr, "Error: --number-density must be between 0 and 1\n");
+            return false;
+        }
+
+        return true;
+    }
+
+    class JsonGenerator {
+        constexpr static const size_t BUFFER_SIZE = 1 << 20;
+
+        const Options& opts;
+        std::FILE* out;
+        std::mt19937_64 rng;
+        std::geometric_distribution<unsigned> string_length;
+
+        std::string buffer;
+        uint64_t written;
+
+        // Random bytes that are not yet used, see `small`.
+        uint64_t random_bits;
+        unsigned random_bytes_left;
+
+    public:
+        JsonGenerator(const Options& opts, std::FILE* out):
+            opts(opts), out(out), rng(opts.seed), string_length(1 / (opts.string_length + 1)), written(0),
+            random_bits(0), random_bytes_left(0) {
+            this->buffer.reserve(BUFFER_SIZE);
+        }
+
+        // Returns false if writing the output failed.
+        bool generate() {
+            this->buffer += "[\n";
+            bool first = true;
+
+            // The size check is performed per top-level value, whose size is bounded by the nesting depth and fanout.
+            while (this->written + this->buffer.size() < opts.size) {
+                if (!first)
+                    this->buffer += ",\n";
+                first = false;
+
+                this->value(opts.max_depth);
+
+                if (this->buffer.size() >= BUFFER_SIZE && !this->flush())
+                    return false;
+            }
+
+            this->buffer += "\n]\n";
+            return this->flush();
+        }
+
+    private:
+        bool flush() {
+            size_t n = std::fwrite(this->buffer.data(), 1, this->buffer.size(), this->out);
+            this->written += n;
+            bool ok = n == this->buffer.size();
+            this->buffer.clear();
+            return ok;
+        }
+
+        unsigned uniform(unsigned min, unsigned max) {
+            return std::uniform_int_distribution<unsigned>(min, max)(this->rng);
+        }
+
+        bool chance(double p) {
+            return std::bernoulli_distribution(p)(this->rng);
+        }
+
+        // Fast random value in [0, n) for n <= 256, for generating individual characters. This uses only a
+        // single byte of randomness, so the distribution is slightly biased if n is not a power of two.
+        unsigned small(unsigned n) {
+            if (this->random_bytes_left == 0) {
+                this->random_bits = this->rng();
+                this->random_bytes_left = sizeof(uint64_t);
+            }
+
+            unsigned byte = this->random_bits & 0xFF;
+            this->random_bits >>= 8;
+            --this->random_bytes_left;
+            return (byte * n) >> 8;
+        }
+
+        // Generate a value that is exactly `depth` levels deep. To keep the size of a value linear in its depth, only
+        // one child of every array or object is of the full depth, the others are mostly scalars.
+        void value(unsigned depth) {
+            if (depth == 0) {
+                this->scalar();
+                return;
+            }
+
+            bool object = this->chance(0.5);
+            unsigned n = this->uniform(1, opts.fanout);
+            unsigned full = this->uniform(0, n - 1);
+
+            this->buffer.push_back(object ? '{' : '[');
+            for (unsigned i = 0; i < n; ++i) {
+                if (i > 0)
+                    this->buffer += ", ";
+
+                if (object) {
+                    this->string();
+                    this->buffer += ": ";
+                }
+
+                if (i == full)
+                    this->value(depth - 1);
+                else if (depth > 1 && this->chance(0.1))
+                    this->value(1);
+                else
+                    this->scalar();
+            }
+            this->buffer.push_back(object ? '}' : ']');
+        }
+
+        void scalar() {
+            if (this->chance(opts.number_density)) {
+                this->number();
+                return;
+            }
+
+            switch (this->uniform(0, 7)) {
+                case 0: this->buffer += "true"; break;
+                case 1: this->buffer += "false"; break;
+                case 2: this->buffer += "null"; break;
+                default: this->string();
+            }
+        }
+
+        void number() {
+            if (this->chance(0.2))
+                this->buffer.push_back('-');
+
+            // Integral part, without leading zeros.
+            unsigned digits = this->uniform(1, 10);
+            if (digits == 1) {
+                this->buffer.push_back('0' + this->small(10));
+            } else {
+                this->buffer.push_back('1' + this->small(9));
+                for (unsigned i = 1; i < digits; ++i)
+                    this->buffer.push_back('0' + this->small(10));
+            }
+
+            if (this->chance(0.5)) {
+                this->buffer.push_back('.');
+                unsigned fraction_digits = this->uniform(1, 8);
+                for (unsigned i = 0; i < fraction_digits; ++i)
+                    this->buffer.push_back('0' + this->small(10));
+            }
+
+            if (this->chance(0.1)) {
+                this->buffer.push_back(this->chance(0.5) ? 'e' : 'E');
+                switch (this->uniform(0, 2)) {
+                    case 0: this->buffer.push_back('+'); break;
+                    case 1: this->buffer.push_back('-'); break;
+                }
+                this->buffer += fmt::format("{}", this->uniform(0, 308));
+            }
+        }
+
+        void string() {
+            static const std::string_view escapes[] = {"\\\"", "\\\\", "\\/", "\\b", "\\f", "\\n", "\\r", "\\t"};
+            static const char hex[] = "0123456789abcdef";
+
+            // Printable ASCII, except for the quote and backslash which need to be escaped.
+            static const auto plain = [] {
+                auto chars = std::string();
+                for (char c = 0x20; c <= 0x7E; ++c) {
+                    if (c != '"' && c != '\\')
+                        chars.push_back(c);
+                }
+                return chars;
+            }();
+
+            unsigned length = this->string_length(this->rng);
+
+            this->buffer.push_back('"');
+            for (unsigned i = 0; i < length; ++i) {
+                unsigned kind = this->small(64);
+                if (kind == 0) {
+                    this->buffer += escapes[this->small(std::size(escapes))];
+                } else if (kind == 1) {
+                    this->buffer += "\\u";
+                    for (unsigned j = 0; j < 4; ++j)
+                        this->buffer.push_back(hex[this->small(16)]);
+                } else {
+                    this->buffer.push_back(plain[this->small(plain.size())]);
+                }
+            }
+            this->buffer.push_back('"');
+        }
+    };
+}
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    if (!parse_options(&opts, argc, argv)) {
+        fmt::print(std::cerr, "See '{} --help' for usage\n", argv[0]);
+        return EXIT_FAILURE;
+    } else if (opts.help) {
+        print_usage(argv[0]);
+        return EXIT_SUCCESS;
+    }
+
+    bool to_stdout = opts.output_path == std::string_view("-");
+    std::FILE* out = to_stdout ? stdout : std::fopen(opts.output_path, "wb");
+    if (!out) {
+        fmt::print(std::cerr, "Error: Failed to open output file '{}': {}\n", opts.output_path, std::strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    bool ok = JsonGenerator(opts, out).generate();
+    ok &= to_stdout ? std::fflush(out) == 0 : std::fclose(out) == 0;
+
+    if (!ok) {
+        fmt::print(std::cerr, "Error: Failed to write output to '{}'\n", opts.output_path);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,529 @@
+// Generator for synthetic programs in the language accepted by the compiler (see src/compiler/parser/pareas.g).
+// The generated programs pass all semantic checks of the compiler, and are used to benchmark how the compiler
+// scales with respect to the shape of its input.
+
+#include <fmt/format.h>
+#include <fmt/ostream.h>
+
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+    struct Options {
+        const char* output_path;
+        bool help;
+        uint64_t seed;
+        unsigned functions;
+        size_t size;
+        unsigned statements;
+        unsigned max_depth;
+        unsigned expr_depth;
+        unsigned vars;
+        unsigned params;
+    };
+
+    void print_usage(char* progname) {
+        fmt::print(
+            "Usage: {} [options...]\n"
+            "Available options:\n"
+            "-o --output <output path>   Write the program to <output path>. (default: -)\n"
+            "-h --help                   Show this message and exit.\n"
+            "--seed <seed>               Seed of the random number generator. (default: 0)\n"
+            "--functions <amount>        Number of functions to generate. (default: 16)\n"
+            "--size <bytes>              Keep generating functions until the program is at\n"
+            "                            least <bytes> large. Overrides --functions.\n"
+            "--statements <amount>       Number of statements per function, including those\n"
+            "                            in nested blocks. (default: 32)\n"
+            "--depth <depth>             Maximum nesting depth of blocks within a\n"
+            "                            function. (default: 3)\n"
+            "--expr-depth <depth>        Maximum depth of expressions. (default: 4)\n"
+            "--vars <amount>             Maximum number of variables declared per scope.\n"
+            "                            (default: 8)\n"
+            "--params <amount>           Maximum number of parameters per function.\n"
+            "                            (default: 4)\n"
+            "\n"
+            "When <output path> is '-', the program is written to standard output. The\n"
+            "first function of the program is the root of the call graph: functions only\n"
+            "call functions declared after them, so the generated programs do not recurse.\n",
+            progname
+        );
+    }
+
+    template <typename T>
+    bool parse_number(const char* arg, const char* option, T* value) {
+        const auto* end = arg + std::strlen(arg);
+        auto [p, ec] = std::from_chars(arg, end, *value);
+        if (ec != std::errc() || p != end) {
+            fmt::print(std::cerr, "Error: Invalid value '{}' for option {}\n", arg, option);
+            return false;
+        }
+        return true;
+    }
+
+    bool parse_options(Options* opts, int argc, char* argv[]) {
+        *opts = {
+            .output_path = nullptr,
+            .help = false,
+            .seed = 0,
+            .functions = 16,
+            .size = 0,
+            .statements = 32,
+            .max_depth = 3,
+            .expr_depth = 4,
+            .vars = 8,
+            .params = 4,
+        };
+
+        for (int i = 1; i < argc; ++i) {
+            auto arg = std::string_view(argv[i]);
+
+            if (arg == "-h" || arg == "--help") {
+                opts->help = true;
+                continue;
+            } else if (arg.size() <= 1 || arg[0] != '-') {
+                fmt::print(std::cerr, "Error: Unexpected argument {}\n", arg);
+                return false;
+            } else if (++i >= argc) {
+                fmt::print(std::cerr, "Error: Expected argument to option {}\n", arg);
+                return false;
+            }
+
+            bool ok = true;
+            if (arg == "-o" || arg == "--output") {
+                opts->output_path = argv[i];
+            } else if (arg == "--seed") {
+                ok = parse_number(argv[i], argv[i - 1], &opts->seed);
+            } else if (arg == "--functions") {
+                ok = parse_number(argv[i], argv[i - 1], &opts->functions);
+            } else if (arg == "--size") {
+                ok = parse_number(argv[i], argv[i - 1], &opts->size);
+            } else if (arg == "--statements") {
+                ok = parse_number(argv[i], argv[i - 1], &opts->statements);
+            } else if (arg == "--depth") {
+                ok = parse_number(argv[i], argv[i - 1], &opts->max_depth);
+            } else if (arg == "--expr-depth") {
+                ok = parse_number(argv[i], argv[i - 1], &opts->expr_depth);
+            } else if (arg == "--vars") {
+                ok = parse_number(argv[i], argv[i - 1], &opts->vars);
+            } else if (arg == "--params") {
+                ok = parse_number(argv[i], argv[i - 1], &opts->params);
+            } else {
+                fmt::print(std::cerr, "Error: Unknown option {}\n", arg);
+                return false;
+            }
+
+            if (!ok)
+                return false;
+        }
+
+        if (opts->help)
+            return true;
+
+        if (!opts->output_path) {
+            opts->output_path = "-";
+        } else if (!opts->output_path[0]) {
+            fmt::print(std::cerr, "Error: <output path> may not be empty\n");
+            return false;
+        }
+
+        if (opts->functions < 1) {
+            fmt::print(std::cerr, "Error: --functions must be at least 1\n");
+            return false;
+        } else if (opts->statements < 1) {
+            fmt::print(std::cerr, "Error: --statements must be at least 1\n");
+            return false;
+        }
+
+        return true;
+    }
+
+    enum class Type {
+        INT,
+        FLOAT,
+        VOID,
+    };
+
+    std::string_view type_name(Type ty) {
+        switch (ty) {
+            case Type::INT: return "int";
+            case Type::FLOAT: return "float";
+            case Type::VOID: return "void";
+        }
+        return "";
+    }
+
+    struct Function {
+        std::string name;
+        Type return_type;
+        std::vector<Type> params;
+    };
+
+    struct Variable {
+        std::string name;
+        Type type;
+        // Loop counters are never assigned outside of the increment of their loop, so that every
+        // generated loop terminates.
+        bool assignable;
+    };
+
+    class ProgramGenerator {
+        const Options& opts;
+        std::mt19937_64 rng;
+
+        // Functions in order of generation. Function `i` only calls functions `0` to `i - 1`, and functions
+        // are emitted in reverse order of generation.
+        std::vector<Function> functions;
+
+        // Variables that are currently visible, and the start of every scope within `vars`.
+        std::vector<Variable> vars;
+        std::vector<size_t> scopes;
+        unsigned next_var;
+
+        std::string out;
+
+    public:
+        ProgramGenerator(const Options& opts):
+            opts(opts), rng(opts.seed), next_var(0) {}
+
+        std::string generate() {
+            auto bodies = std::vector<std::string>();
+            size_t total_size = 0;
+
+            auto add_function = [&](bool root) {
+                this->out.clear();
+                this->function(bodies.size(), root);
+                total_size += this->out.size();
+                bodies.push_back(std::move(this->out));
+            };
+
+            while (opts.size > 0 ? total_size < opts.size : bodies.size() + 1 < opts.functions)
+                add_function(false);
+            add_function(true);
+
+            // Emit the root of the call graph first, so that it gets function id 0.
+            auto program = std::string();
+            program.reserve(total_size);
+            for (auto it = bodies.rbegin(); it != bodies.rend(); ++it)
+                program += *it;
+
+            return program;
+        }
+
+    private:
+        unsigned uniform(unsigned min, unsigned max) {
+            return std::uniform_int_distribution<unsigned>(min, max)(this->rng);
+        }
+
+        bool chance(double p) {
+            return std::bernoulli_distribution(p)(this->rng);
+        }
+
+        template <typename T>
+        const T& pick(const std::vector<T>& values) {
+            return values[this->uniform(0, values.size() - 1)];
+        }
+
+        void indent(unsigned depth) {
+            this->out.append(4 * depth, ' ');
+        }
+
+        Type value_type() {
+            return this->chance(0.75) ? Type::INT : Type::FLOAT;
+        }
+
+        void function(size_t index, bool root) {
+            auto fn = Function{
+                fmt::format("f{}", index),
+                Type::INT,
+                {}
+            };
+
+            // The root is called by the startup code of executables, so it takes no parameters and returns an int.
+            if (!root) {
+                fn.return_type = this->chance(0.1) ? Type::VOID : this->value_type();
+                unsigned num_params = this->uniform(0, opts.params);
+                for (unsigned i = 0; i < num_params; ++i)
+                    fn.params.push_back(this->value_type());
+            }
+
+            this->vars.clear();
+            this->scopes.clear();
+            this->next_var = 0;
+            this->scopes.push_back(0);
+
+            this->out += fmt::format("fn {}[", fn.name);
+            for (size_t i = 0; i < fn.params.size(); ++i) {
+                auto name = fmt::format("p{}", i);
+                this->out += fmt::format("{}{}: {}", i == 0 ? "" : ", ", name, type_name(fn.params[i]));
+                this->vars.push_back({std::move(name), fn.params[i], true});
+            }
+            this->out += fmt::format("]: {} {{\n", type_name(fn.return_type));
+
+            this->block(1, opts.statements, fn.return_type);
+
+            this->out += fmt::format("}}\n\n");
+            this->functions.push_back(std::move(fn));
+        }
+
+        // Generate `budget` statements in total, nested blocks included. If `return_type` is not void,
+        // the block ends with a return statement.
+        void block(unsigned depth, unsigned budget, Type return_type) {
+            while (budget > 0) {
+                --budget;
+
+                // Nested statements take a part of the remaining budget for their bodies.
+                bool can_nest = depth <= opts.max_depth && budget > 0;
+                unsigned choice = this->uniform(0, can_nest ? 9 : 5);
+
+                if (choice <= 1 && this->num_scope_vars() < opts.vars) {
+                    this->declaration(depth);
+                } else if (choice <= 3 && this->has_assignable()) {
+                    this->assignment(depth);
+                } else if (choice <= 5) {
+                    this->call_statement(depth);
+                } else if (choice <= 7) {
+                    this->if_statement(depth, budget);
+                } else if (choice == 8) {
+                    this->while_statement(depth, budget);
+                } else {
+                    unsigned body = this->uniform(1, budget);
+                    budget -= body;
+                    this->indent(depth);
+                    this->out += fmt::format("{{\n");
+                    this->scoped_block(depth + 1, body);
+                    this->indent(depth);
+                    this->out += fmt::format("}}\n");
+                }
+            }
+
+            if (return_type != Type::VOID) {
+                this->indent(depth);
+                this->out += fmt::format("return {};\n", this->expr(return_type, this->uniform(0, opts.expr_depth)));
+            }
+        }
+
+        void scoped_block(unsigned depth, unsigned budget) {
+            this->scopes.push_back(this->vars.size());
+            this->block(depth, budget, Type::VOID);
+            this->vars.resize(this->scopes.back());
+            this->scopes.pop_back();
+        }
+
+        size_t num_scope_vars() const {
+            return this->vars.size() - this->scopes.back();
+        }
+
+        bool has_assignable() const {
+            return std::any_of(this->vars.begin(), this->vars.end(), [](const auto& var) {
+                return var.assignable;
+            });
+        }
+
+        Variable& declare(Type ty, bool assignable) {
+            return this->vars.emplace_back(Variable{fmt::format("v{}", this->next_var++), ty, assignable});
+        }
+
+        void declaration(unsigned depth) {
+            auto ty = this->value_type();
+            // Generate the initializer before declaring, the variable is not in scope in its own initializer.
+            auto init = this->expr(ty, this->uniform(0, opts.expr_depth));
+            const auto& var = this->declare(ty, true);
+            this->indent(depth);
+            this->out += fmt::format("var {}: {} = {};\n", var.name, type_name(ty), init);
+        }
+
+        void assignment(unsigned depth) {
+            auto assignable = std::vector<const Variable*>();
+            for (const auto& var : this->vars) {
+                if (var.assignable)
+                    assignable.push_back(&var);
+            }
+
+            const auto* var = this->pick(assignable);
+            this->indent(depth);
+            this->out += fmt::format("{} = {};\n", var->name, this->expr(var->type, this->uniform(0, opts.expr_depth)));
+        }
+
+        void call_statement(unsigned depth) {
+            this->indent(depth);
+            if (this->functions.empty()) {
+                // Nothing to call yet, so just evaluate an expression.
+                this->out += fmt::format("{};\n", this->expr(this->value_type(), this->uniform(0, opts.expr_depth)));
+            } else {
+                this->out += fmt::format("{};\n", this->call(this->pick(this->functions), opts.expr_depth));
+            }
+        }
+
+        void if_statement(unsigned depth, unsigned& budget) {
+            unsigned num_elifs = this->uniform(0, 2);
+            bool has_else = this->chance(0.5);
+
+            this->indent(depth);
+            this->out += fmt::format("if {} ", this->condition());
+            this->branch(depth, budget);
+
+            for (unsigned i = 0; i < num_elifs && budget > 0; ++i) {
+                this->indent(depth);
+                this->out += fmt::format("elif {} ", this->condition());
+                this->branch(depth, budget);
+            }
+
+            if (has_else && budget > 0) {
+                this->indent(depth);
+                this->out += fmt::format("else ");
+                this->branch(depth, budget);
+            }
+        }
+
+        void branch(unsigned depth, unsigned& budget) {
+            unsigned body = budget == 0 ? 0 : this->uniform(1, std::max(1u, budget / 2));
+            budget -= body;
+            this->out += fmt::format("{{\n");
+            this->scoped_block(depth + 1, body);
+            this->indent(depth);
+            this->out += fmt::format("}}\n");
+        }
+
+        void while_statement(unsigned depth, unsigned& budget) {
+            auto counter = this->declare(Type::INT, false).name;
+            this->indent(depth);
+            this->out += fmt::format("var {}: int = 0;\n", counter);
+
+            unsigned body = this->uniform(1, std::max(1u, budget / 2));
+            budget -= body;
+
+            this->indent(depth);
+            this->out += fmt::format("while {} < {} {{\n", counter, this->uniform(1, 100));
+            this->scoped_block(depth + 1, body);
+            this->indent(depth + 1);
+            this->out += fmt::format("{0} = {0} + 1;\n", counter);
+            this->indent(depth);
+            this->out += fmt::format("}}\n");
+        }
+
+        std::string condition() {
+            return this->expr(Type::INT, std::max(1u, this->uniform(0, opts.expr_depth)));
+        }
+
+        std::string call(const Function& fn, unsigned depth) {
+            auto args = std::vector<std::string>();
+            for (auto ty : fn.params)
+                args.push_back(this->expr(ty, this->uniform(0, std::min(depth, 2u))));
+
+            return fmt::format("{}[{}]", fn.name, fmt::join(args, ", "));
+        }
+
+        std::string leaf(Type ty) {
+            auto candidates = std::vector<const Variable*>();
+            for (const auto& var : this->vars) {
+                if (var.type == ty)
+                    candidates.push_back(&var);
+            }
+
+            if (!candidates.empty() && this->chance(0.7))
+                return this->pick(candidates)->name;
+            else if (ty == Type::INT)
+                return fmt::format("{}", this->uniform(0, 1000));
+            else
+                return fmt::format("{}.{}", this->uniform(0, 1000), this->uniform(0, 99));
+        }
+
+        // Generate an expression of type `ty` that is exactly `depth` levels deep. To keep the size of the
+        // expression linear in its depth, only one operand of every operator is of the full depth.
+        // Every non-leaf expression is either parenthesized or an atom, so that operator precedence
+        // does not matter.
+        std::string expr(Type ty, unsigned depth) {
+            if (depth == 0)
+                return this->leaf(ty);
+
+            auto sub = [&](Type sub_ty, bool full) {
+                return this->expr(sub_ty, full ? depth - 1 : this->uniform(0, std::min(depth - 1, 2u)));
+            };
+
+            auto binary = [&](Type sub_ty, std::string_view op) {
+                bool left_full = this->chance(0.5);
+                auto lhs = sub(sub_ty, left_full);
+                auto rhs = sub(sub_ty, !left_full);
+                return fmt::format("({} {} {})", lhs, op, rhs);
+            };
+
+            auto callees = std::vector<const Function*>();
+            for (const auto& fn : this->functions) {
+                if (fn.return_type == ty)
+                    callees.push_back(&fn);
+            }
+
+            unsigned choice = this->uniform(0, callees.empty() ? 8 : 9);
+
+            if (ty == Type::INT) {
+                static const std::vector<std::string_view> arith_ops = {
+                    "+", "-", "*", "/", "%", "&", "|", "^", "<<", ">>", ">>>"
+                };
+                static const std::vector<std::string_view> rela_ops = {"==", "!=", "<", "<=", ">", ">="};
+                static const std::vector<std::string_view> logical_ops = {"&&", "||"};
+                static const std::vector<std::string_view> unary_ops = {"-", "~", "!"};
+
+                switch (choice) {
+                    case 0: case 1: case 2:
+                        return binary(Type::INT, this->pick(arith_ops));
+                    case 3: case 4:
+                        return binary(this->value_type(), this->pick(rela_ops));
+                    case 5:
+                        return binary(Type::INT, this->pick(logical_ops));
+                    case 6: case 7:
+                        return fmt::format("{}{}", this->pick(unary_ops), sub(Type::INT, true));
+                    case 8:
+                        return fmt::format("int({})", sub(Type::FLOAT, true));
+                    default:
+                        return this->call(*this->pick(callees), depth - 1);
+                }
+            } else {
+                static const std::vector<std::string_view> arith_ops = {"+", "-", "*", "/"};
+
+                switch (choice) {
+                    case 0: case 1: case 2: case 3: case 4:
+                        return binary(Type::FLOAT, this->pick(arith_ops));
+                    case 5: case 6:
+                        return fmt::format("-{}", sub(Type::FLOAT, true));
+                    case 7: case 8:
+                        return fmt::format("float({})", sub(Type::INT, true));
+                    default:
+                        return this->call(*this->pick(callees), depth - 1);
+                }
+            }
+        }
+    };
+}
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    if (!parse_options(&opts, argc, argv)) {
+        fmt::print(std::cerr, "See '{} --help' for usage\n", argv[0]);
+        return EXIT_FAILURE;
+    } else if (opts.help) {
+        print_usage(argv[0]);
+        return EXIT_SUCCESS;
+    }
+
+    auto program = ProgramGenerator(opts).generate();
+
+    if (opts.output_path == std::string_view("-")) {
+        std::cout << program;
+    } else {
+        auto out = std::ofstream(opts.output_path, std::ios::binary);
+        if (!out || !out.write(program.data(), program.size())) {
+            fmt::print(std::cerr, "Error: Failed to write output to '{}'\n", opts.output_path);
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}